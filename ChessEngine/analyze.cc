@@ -0,0 +1,294 @@
+#include "analyze.h"
+#include "engine.h"
+#include "util.h"
+#include "fen.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int kDefaultDepth = 10;
+
+    // Lines read ahead of the oldest unwritten result.
+    // Bounds the memory used by the pending positions
+    // and the results that wait for their turn.
+    const size_t kMaxInFlight = 4096;
+
+    // Hands out the input lines to the workers in order and
+    // collects the results so that they are written in the input
+    // order. A worker takes the next line as soon as it's done with
+    // the previous one, so slow positions don't hold up the others.
+    class WorkQueue
+    {
+    public:
+        WorkQueue(std::FILE *output) : output_(output) {}
+
+        // Called by the reader. Blocks while too many
+        // lines are waiting for their results.
+        void Push(std::string line)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            space_.wait(lock, [this]{return read_ - written_ < kMaxInFlight;});
+
+            lines_.emplace_back(read_++, std::move(line));
+            work_.notify_one();
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            work_.notify_all();
+        }
+
+        // Returns false when there are no lines left.
+        bool Pop(u64 *index, std::string *line)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_.wait(lock, [this]{return closed_ || !lines_.empty();});
+
+            if(lines_.empty())
+                return false;
+
+            *index = lines_.front().first;
+            *line = std::move(lines_.front().second);
+            lines_.pop_front();
+            return true;
+        }
+
+        // Stores the result and writes the results
+        // that are next in the input order.
+        void Done(u64 index, std::string result)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            results_.emplace(index, std::move(result));
+
+            for(auto next = results_.begin(); next != results_.end() && next->first == written_; next = results_.begin())
+            {
+                std::fputs(next->second.c_str(), output_);
+                std::fputc('\n', output_);
+                results_.erase(next);
+                ++written_;
+            }
+
+            space_.notify_one();
+        }
+
+        u64 Written()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return written_;
+        }
+
+    private:
+        std::FILE *output_;
+
+        std::mutex mutex_;
+        std::condition_variable work_;
+        std::condition_variable space_;
+
+        std::deque<std::pair<u64, std::string>> lines_;
+        std::map<u64, std::string> results_;
+
+        u64 read_ = 0;
+        u64 written_ = 0;
+        bool closed_ = false;
+    };
+
+    // Analyzes one EPD line and returns the output line.
+    std::string analyze_line(Engine *engine, const std::string& line, const AnalyzeParameters& parameters)
+    {
+        Board& board = engine->board;
+
+        std::string_view operations;
+        if(!board.SetPositionFromEPD(line, &operations))
+            return line + " c0 \"invalid position\";";
+
+        char epd[fen::kMaxFenLength];
+        fen::write(board, epd, true);
+
+        Search& search = engine->search;
+        search.depth = parameters.depth;
+        search.nodes = parameters.nodes;
+        search.duration = parameters.movetime;
+        search.infinite = false;
+
+        if(!search.depth && !search.nodes && !search.duration)
+            search.depth = kDefaultDepth;
+
+        // The info of the last completed iteration.
+        SearchInfo last = {};
+        std::string pv;
+        search.info_callback = [&last, &pv](const SearchInfo& info){
+            if(info.multipv != 1)
+                return;
+
+            last = info;
+            pv.clear();
+            for(int i = 0; i < info.pv_length; ++i)
+                pv += (i?" ":"") + move_to_uci(info.pv[i]);
+        };
+
+        engine->Go();
+        engine->Wait();
+
+        search.info_callback = nullptr;
+
+        // The operations of the input line, such as the id, are
+        // kept so that the results can be matched with the input.
+        while(!operations.empty() && std::isspace((unsigned char)operations.front()))
+            operations.remove_prefix(1);
+        while(!operations.empty() && std::isspace((unsigned char)operations.back()))
+            operations.remove_suffix(1);
+
+        std::ostringstream result;
+        result << epd;
+        if(!operations.empty())
+            result << " " << operations;
+        result << " bm " << move_to_uci(search.best_move) << ";";
+
+        // Without a legal move no iteration is reported and
+        // the score is the mate or the stalemate.
+        if(last.mate)
+            result << " dm " << last.score << ";";
+        else if(search.best_eval == -evaluation::kMateScore)
+            result << " dm 0;";
+        else
+            result << " ce " << search.best_eval << ";";
+
+        result << " acd " << last.depth << "; pv " << pv << ";";
+        return result.str();
+    }
+
+    void run_worker(WorkQueue *queue, const AnalyzeParameters& parameters)
+    {
+        Engine engine;
+        std::string error;
+        engine.SetOption("Hash", std::to_string(parameters.hash_mb), &error);
+        engine.search.silent = true;
+
+        u64 index;
+        std::string line;
+        while(queue->Pop(&index, &line))
+            queue->Done(index, analyze_line(&engine, line, parameters));
+    }
+}
+
+namespace analyze
+{
+
+bool run(const AnalyzeParameters& parameters)
+{
+    std::ifstream input(parameters.input);
+    if(!input)
+    {
+        std::cerr << "Couldn't open " << parameters.input << "\n";
+        return false;
+    }
+
+    std::FILE *output = stdout;
+    if(!parameters.output.empty())
+    {
+        output = std::fopen(parameters.output.c_str(), "w");
+        if(output == nullptr)
+        {
+            std::cerr << "Couldn't open " << parameters.output << "\n";
+            return false;
+        }
+    }
+
+    int threads = parameters.threads;
+    if(threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto start = std::chrono::steady_clock::now();
+
+    WorkQueue queue(output);
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i)
+        workers.emplace_back(run_worker, &queue, std::cref(parameters));
+
+    // Lines are streamed to the workers while the file is read.
+    std::string line;
+    while(std::getline(input, line))
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if(!line.empty())
+            queue.Push(std::move(line));
+    }
+
+    queue.Close();
+    for(std::thread& worker : workers)
+        worker.join();
+
+    if(output != stdout)
+        std::fclose(output);
+    else
+        std::fflush(output);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    u64 positions = queue.Written();
+
+    std::cerr << "Analyzed " << positions << " positions in " << seconds << " s ("
+              << (u64)(positions / std::max(seconds, 0.001)) << " positions/s)\n";
+
+    return true;
+}
+
+bool parse_arguments(int argc, char **argv, AnalyzeParameters *parameters)
+{
+    if(argc < 1)
+        return false;
+
+    parameters->input = argv[0];
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string name = argv[i];
+        if(i + 1 >= argc)
+        {
+            std::cerr << "Missing parameter to " << name << "\n";
+            return false;
+        }
+
+        std::string value = argv[++i];
+
+        try
+        {
+            if(name == "--depth") parameters->depth = std::stoi(value);
+            else if(name == "--nodes") parameters->nodes = std::stoull(value);
+            else if(name == "--movetime") parameters->movetime = std::stoi(value);
+            else if(name == "--threads") parameters->threads = std::stoi(value);
+            else if(name == "--hash") parameters->hash_mb = std::stoi(value);
+            else if(name == "--output") parameters->output = value;
+            else
+            {
+                std::cerr << "Unknown argument " << name << "\n";
+                return false;
+            }
+        }
+        catch(const std::exception&)
+        {
+            std::cerr << "Invalid value for " << name << ": " << value << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef ANALYZE_H_
+#define ANALYZE_H_
+
+#include "types.h"
+
+#include <string>
+
+// Parameters of the analyze mode. The limits apply to each
+// position, 0 for no limit. A depth of 10 is used if no limit
+// is given.
+struct AnalyzeParameters
+{
+    std::string input;
+
+    // Written to stdout if empty.
+    std::string output;
+
+    int depth = 0;
+    u64 nodes = 0;
+    int movetime = 0;
+
+    // 0 to use all the cores.
+    int threads = 0;
+
+    // Transposition table size of each worker.
+    int hash_mb = 16;
+};
+
+namespace analyze
+{
+    // Analyzes the positions of an EPD file on a pool of workers, one
+    // single threaded search each. The output has a line for every
+    // input position, in the input order, with the operations of
+    // the input line followed by the opcodes bm (best move in UCI
+    // notation), ce (centipawns) or dm (mate in moves, 0 if the
+    // side to move is mated), acd (depth) and pv.
+    // Returns false if the files couldn't be opened.
+    bool run(const AnalyzeParameters& parameters);
+
+    // Parses the command line arguments that follow "analyze":
+    // file.epd [--depth d] [--nodes n] [--movetime ms] [--threads t]
+    // [--hash mb] [--output file]. Returns false on an error.
+    bool parse_arguments(int argc, char **argv, AnalyzeParameters *parameters);
+}
+
+#endif // ANALYZE_H_
@@ -8,7 +8,7 @@ namespace
 
 void init_pawn_attacks()
 {
-	std::cout << "Initializing pawn attacks...\n";
+	std::cerr << "Initializing pawn attacks...\n";
 	for (Bitboard square_bb = kBitboardMSB;square_bb > 0;square_bb >>= 1)
 	{
 		int square = square_from_bitboard(square_bb);
@@ -41,7 +41,7 @@ void init_pawn_attacks()
 
 void init_knight_attacks()
 {
-	std::cout << "Initializing knight attacks...\n";
+	std::cerr << "Initializing knight attacks...\n";
 	for (Bitboard square_bb = kBitboardMSB;square_bb > 0;square_bb >>= 1)
 	{
 		int square = square_from_bitboard(square_bb);
@@ -108,7 +108,7 @@ void init_knight_attacks()
 
 void init_bishop_attacks()
 {
-	std::cout << "Initializing bishop attacks...\n";
+	std::cerr << "Initializing bishop attacks...\n";
 	for (Bitboard square_bb = kBitboardMSB;square_bb > 0;square_bb >>= 1)
 	{
 		int square = square_from_bitboard(square_bb);
@@ -160,7 +160,7 @@ void init_bishop_attacks()
 
 void init_rook_attacks()
 {
-	std::cout << "Initializing rook attacks...\n";
+	std::cerr << "Initializing rook attacks...\n";
 	for (Bitboard square_bb = kBitboardMSB;square_bb > 0;square_bb >>= 1)
 	{
 		int square = square_from_bitboard(square_bb);
@@ -212,7 +212,7 @@ void init_rook_attacks()
 
 void init_queen_attacks()
 {
-	std::cout << "Initializing queen attacks...\n";
+	std::cerr << "Initializing queen attacks...\n";
 	for (Bitboard square_bb = kBitboardMSB;square_bb > 0;square_bb >>= 1)
 	{
 		int square = square_from_bitboard(square_bb);
@@ -225,7 +225,7 @@ void init_queen_attacks()
 
 void init_king_attacks()
 {
-	std::cout << "Initializing king attacks...\n";
+	std::cerr << "Initializing king attacks...\n";
 	for (Bitboard square_bb = kBitboardMSB;square_bb > 0;square_bb >>= 1)
 	{
 		int square = square_from_bitboard(square_bb);
@@ -1,9 +1,11 @@
 #include "board.h"
+#include "fen.h"
 #include "bitboards.h"
 #include "util.h"
 #include "attacks.h"
 #include "evaluate.h"
 #include "magic_bitboards.h"
+#include "move_generation.h"
 
 #include <iostream>
 #include <sstream>
@@ -11,6 +13,10 @@
 #include <random>
 
 u64 Board::zobrist_table[NUM_PIECE_TYPES][NUM_SQUARES];
+u64 Board::zobrist_side;
+u64 Board::zobrist_castling[16];
+u64 Board::zobrist_en_passant[NUM_FILES];
+u64 Board::zobrist_material[NUM_PIECE_TYPES][NUM_SQUARES];
 
 //TODO fix this rng stuff
 std::random_device rd2; 
@@ -18,6 +24,38 @@ std::mt19937 gen(rd2());
 
 using namespace magic_bitboards;
 
+namespace
+{
+    inline void add_dirty_piece(nnue::DirtyPieces *dirty, PieceType piece, Square from, Square to)
+    {
+        dirty->piece[dirty->count] = piece;
+        dirty->from[dirty->count] = from;
+        dirty->to[dirty->count] = to;
+        ++dirty->count;
+    }
+
+    // Returns the castling rights that remain when a
+    // piece moves from or to the given square.
+    u8 castling_mask(Square square)
+    {
+        switch(square)
+        {
+            case A1: return 0xF & ~WHITE_QUEENSIDE;
+            case H1: return 0xF & ~WHITE_KINGSIDE;
+            case E1: return 0xF & ~(WHITE_KINGSIDE | WHITE_QUEENSIDE);
+            case A8: return 0xF & ~BLACK_QUEENSIDE;
+            case H8: return 0xF & ~BLACK_KINGSIDE;
+            case E8: return 0xF & ~(BLACK_KINGSIDE | BLACK_QUEENSIDE);
+            default: return 0xF;
+        }
+    }
+
+    inline int square_file(Square square)
+    {
+        return square % NUM_FILES;
+    }
+}
+
 Board::Board()
 {
     Reset();
@@ -35,6 +73,15 @@ Board& Board::operator=(const Board& board)
 
     this->state_ = board.state_;
     this->history_ = board.history_;
+    this->psq_ = board.psq_;
+    this->material_key_ = board.material_key_;
+    std::copy(board.piece_count_, board.piece_count_ + NUM_PIECE_TYPES, this->piece_count_);
+
+    // The accumulators of the earlier plies are
+    // rarely needed, so they aren't copied.
+    this->accumulators_.assign(1, board.accumulators_[board.accumulator_top_]);
+    this->accumulator_top_ = 0;
+    this->network_ = board.network_;
 
     return *this;
 }
@@ -42,6 +89,7 @@ Board& Board::operator=(const Board& board)
 void Board::Reset()
 {
     state_.hash = 0;
+    state_.pawn_hash = 0;
     state_.side_to_move = WHITE;
     state_.castling_rights = 0xF;
     state_.half_moves = 0;
@@ -51,6 +99,12 @@ void Board::Reset()
     state_.king_has_moved[1] = false;
 
     std::fill(pieces_,pieces_+NUM_PIECE_TYPES,0);
+
+    psq_ = {0, 0};
+    material_key_ = 0;
+    std::fill(piece_count_,piece_count_+NUM_PIECE_TYPES,0);
+
+    ResetAccumulators();
 }
 
 void Board::Reset(Bitboard *pieces, const State& state)
@@ -59,208 +113,94 @@ void Board::Reset(Bitboard *pieces, const State& state)
 
     for(int i = WHITE_PAWNS; i < NUM_PIECE_TYPES; ++i)
         pieces_[i] = *(pieces+i);
+
+    UpdateMaterial();
+    ResetAccumulators();
 }
 
-bool Board::SetPositionFromFEN(const std::string& fen_string)
+void Board::ResetAccumulators()
 {
-    // Take copies of board state so that the board
-    // can be reset if an error occurs.
-    /*
-    Bitboard pieces_copy[NUM_PIECE_TYPES];
-    State state_copy = state_;
-
-    for(int piece = WHITE_PAWNS; piece < NUM_PIECE_TYPES; ++piece)
-        pieces_copy[piece] = pieces_[piece];
-        */
-
-    Reset();
-    state_.castling_rights = 0;
+    if(accumulators_.empty())
+        accumulators_.resize(1);
 
-    Bitboard curr_square = kBitboardRank8 & kBitboardFileA;
+    accumulator_top_ = 0;
+    accumulators_[0].computed[WHITE] = false;
+    accumulators_[0].computed[BLACK] = false;
+    accumulators_[0].dirty.count = 0;
+}
 
-    enum State{POSITION,SIDE,CASTLING,EN_PASSANT,HALF_MOVES,FULL_MOVES};
-    int curr_state = POSITION;
+void Board::SetNetwork(std::shared_ptr<const nnue::Network> network)
+{
+    if(network == network_) return;
 
-    for(int i=0;i<fen_string.size();++i)
+    // The accumulators were computed with the previous network.
+    network_ = std::move(network);
+    for(size_t i = 0; i <= accumulator_top_; ++i)
     {
-        switch(curr_state)
-        {
-            case POSITION:
-            {
-                if(fen_string[i] == ' ')
-                {
-                    curr_state = SIDE;
-                    continue;
-                }
-
-                if(is_valid_piece_character(fen_string[i]))
-                {
-                    pieces_[(int)piece_type_from_character(fen_string[i])] |= curr_square;
-                    curr_square >>= 1;
-                    continue;
-                }
-
-                int number = fen_string[i] - '0';
-                if(number >= 0 && number <= NUM_FILES)
-                    curr_square >>= number;
-                break;
-            }
-            case SIDE: 
-            {
-                if(fen_string[i] == ' ')
-                {
-                    curr_state = CASTLING;
-                    continue;
-                }
-
-                state_.side_to_move = (fen_string[i] == 'w')?WHITE:BLACK;
-                break;
-            }
-            case CASTLING:
-            {
-                if(fen_string[i] == ' ')
-                {
-                    curr_state = EN_PASSANT;
-                    continue;
-                }
-
-                if(fen_string[i] == '-')
-                    continue;
-                else
-                {
-                    switch(fen_string[i]) 
-                    {
-                        case 'K': state_.castling_rights |= WHITE_KINGSIDE; break;
-                        case 'Q': state_.castling_rights |= WHITE_QUEENSIDE; break;
-                        case 'k': state_.castling_rights |= BLACK_KINGSIDE; break;
-                        case 'q': state_.castling_rights |= BLACK_QUEENSIDE; break;
-                    }
-                }
-                break;
-            }
-            case EN_PASSANT:
-            {
-                if(fen_string[i] == ' ')
-                {
-                    curr_state = HALF_MOVES;
-                    continue;
-                }
-
-                if(fen_string[i] == '-')
-                {
-                    state_.en_passant_square = SQUARE_NONE;
-                }
-                else
-                {
-                    state_.en_passant_square = square_from_bitboard(BitboardFromAlgebraic(std::string() + fen_string[i] + fen_string[++i])); 
-                }
-                break;
-            }
-            case HALF_MOVES:
-            {
-                std::string half_moves(""); 
-                for(int j=0;j<3;++j)
-                {
-					int index = i + j;
-					if (index == fen_string.size() || fen_string[index] == ' ')
-                    {
-                        i+=j;
-                        break;
-                    }
-                    half_moves+=fen_string[i+j];
-                }
-
-                state_.half_moves = std::stoi(half_moves,nullptr);
-                curr_state = FULL_MOVES;
-                break;
-            }
-            case FULL_MOVES:
-            {
-                std::string full_moves(""); 
-                for(int j=0;j<3;++j)
-                {
-					int index = i + j;
-                    if(index == fen_string.size() || fen_string[index] == ' ')
-                    {
-                        i+=j;
-                        break;
-                    }
-                    full_moves+=fen_string[i+j];
-                }
-
-                state_.full_moves= std::stoi(full_moves,nullptr);
-                break;
-            }
-        }
+        accumulators_[i].computed[WHITE] = false;
+        accumulators_[i].computed[BLACK] = false;
     }
+}
 
-	if (curr_state != FULL_MOVES) 
-    {
-        //Reset(pieces_copy,state_copy);
-        return false;
-    }
+nnue::DirtyPieces* Board::PushAccumulator()
+{
+    if(++accumulator_top_ == accumulators_.size())
+        accumulators_.resize(accumulators_.size() * 2);
 
-    UpdateZobristHash(); 
-	return true;
+    nnue::Accumulator *accumulator = &accumulators_[accumulator_top_];
+    accumulator->computed[WHITE] = false;
+    accumulator->computed[BLACK] = false;
+    accumulator->dirty.count = 0;
+
+    return &accumulator->dirty;
 }
 
-std::string Board::GenerateFenString() const
+void Board::PopAccumulator()
 {
-	std::stringstream fen;
+    if(accumulator_top_ > 0)
+    {
+        --accumulator_top_;
+        return;
+    }
 
-	int empty_squares = 0;
-	for (int curr_square = A8; curr_square < SQUARE_NONE; ++curr_square)
-	{
-		if ((curr_square != 0) && ((curr_square % NUM_FILES) == 0))
-		{
-			if (empty_squares)
-			{
-				fen << empty_squares;
-				empty_squares = 0;
-			}
-            
-            if(curr_square != NUM_SQUARES)
-                fen << '/';
-		}
-
-		PieceType curr_piece = PIECE_TYPE_NONE;
-		if ((curr_piece = this->GetPieceOnSquare((Square)curr_square)) != PIECE_TYPE_NONE)
-		{
-			if (empty_squares)
-			{
-				fen << empty_squares;
-				empty_squares = 0;
-			}
-
-			char character = piece_character(curr_piece);
-			fen << character;
-		}
-		else 
-			++empty_squares;
-	}
+    // The accumulator of the previous position wasn't
+    // copied with the board so it has to be recalculated.
+    accumulators_[0].computed[WHITE] = false;
+    accumulators_[0].computed[BLACK] = false;
+}
 
-	fen << ' ' << ((state_.side_to_move == WHITE) ? "w " : "b ");
+bool Board::SetPositionFromFEN(std::string_view fen_string)
+{
+    // The board is left unchanged if the string is invalid.
+    Bitboard pieces[NUM_PIECE_TYPES];
+    State state;
+    if(!fen::parse(fen_string, pieces, &state))
+        return false;
 
-	if (state_.castling_rights == 0)
-		fen << "-";
-	else
-	{
-		for (int i = 0; i < 4; ++i)
-		{
-			if (state_.castling_rights & (0x1 << i))
-				fen << "qkQK"[i];
-		}
-	}
+    history_.clear();
+    Reset(pieces, state);
+    UpdateZobristHash();
+	return true;
+}
 
-	if (state_.en_passant_square != SQUARE_NONE)
-		fen << ' ' << algebraic_from_square((Square)state_.en_passant_square);
-	else
-		fen << " -";
+bool Board::SetPositionFromEPD(std::string_view epd, std::string_view *operations)
+{
+    Bitboard pieces[NUM_PIECE_TYPES];
+    State state;
+    if(!fen::parse_epd(epd, pieces, &state, operations))
+        return false;
 
-	fen << " " << state_.half_moves;
-	fen << " " << state_.full_moves;
+    history_.clear();
+    Reset(pieces, state);
+    UpdateZobristHash();
+    return true;
+}
 
-	return fen.str();
+std::string Board::GenerateFenString() const
+{
+    char fen[fen::kMaxFenLength];
+    size_t length = fen::write(*this, fen);
+    return std::string(fen, length);
 }
 
 void Board::MovePiece(Square from, Square to)
@@ -275,23 +215,54 @@ void Board::MovePiece(Square from, Square to, PieceType piece)
     Bitboard to_bb = bb_from_square(to);
     Bitboard from_to_bb = from_bb | to_bb;
     pieces_[piece] ^= from_to_bb;
+
+    psq_ += evaluation::psq[piece][to] - evaluation::psq[piece][from];
+}
+
+void Board::AddPiece(PieceType piece, Square square)
+{
+    pieces_[piece] |= bb_from_square(square);
+    psq_ += evaluation::psq[piece][square];
+    material_key_ ^= zobrist_material[piece][piece_count_[piece]++];
+}
+
+void Board::RemovePiece(PieceType piece, Square square)
+{
+    pieces_[piece] &= ~bb_from_square(square);
+    psq_ -= evaluation::psq[piece][square];
+    material_key_ ^= zobrist_material[piece][--piece_count_[piece]];
 }
 
 void Board::MakeMove(Move move)
 {
     history_.push_back({state_,move});
+    nnue::DirtyPieces *dirty = PushAccumulator();
 
 	if (piece_of_type(move.piece, KINGS) && !state_.king_has_moved[state_.side_to_move])
 	{
 		state_.king_has_moved[state_.side_to_move] = true;
 	}
 
+    // Remove the old castling rights, en passant square 
+    // and side from the hash. The new ones are added 
+    // after the move has been made.
+    u64 hash = state_.hash ^ zobrist_castling[state_.castling_rights] ^ zobrist_side;
+    if(state_.en_passant_square != SQUARE_NONE)
+        hash ^= zobrist_en_passant[square_file(state_.en_passant_square)];
+
     Side side = state_.side_to_move;
     state_.side_to_move = ((state_.side_to_move == WHITE)?BLACK:WHITE);
 
     state_.en_passant_square = SQUARE_NONE;
-    state_.half_moves++;
-    if(state_.full_moves != 1 && side == WHITE) state_.full_moves++;
+
+    // Captures and pawn moves can't be undone, 
+    // which starts the fifty move count again.
+    if(move.capture || piece_of_type(move.piece, PAWNS))
+        state_.half_moves = 0;
+    else
+        state_.half_moves++;
+
+    if(side == BLACK) state_.full_moves++;
 
     switch(move.type)
     {
@@ -303,6 +274,7 @@ void Board::MakeMove(Move move)
             // square is the square behind 
             // the destination square.
             state_.en_passant_square = (Square)((side == WHITE)?move.to+SQUARE_DIRECTION_DOWN:move.to+SQUARE_DIRECTION_UP);
+            hash ^= zobrist_en_passant[square_file(state_.en_passant_square)];
             break;
         }
         // The king moves for 
@@ -315,11 +287,15 @@ void Board::MakeMove(Move move)
             if(side == WHITE) 
             {
                 MovePiece(H1,F1,WHITE_ROOKS);
+                add_dirty_piece(dirty,WHITE_ROOKS,H1,F1);
+                hash ^= zobrist_table[WHITE_ROOKS][H1] ^ zobrist_table[WHITE_ROOKS][F1];
                 state_.castling_rights &= ~WHITE_KINGSIDE;
             }
             else 
             {
                 MovePiece(H8,F8,BLACK_ROOKS);
+                add_dirty_piece(dirty,BLACK_ROOKS,H8,F8);
+                hash ^= zobrist_table[BLACK_ROOKS][H8] ^ zobrist_table[BLACK_ROOKS][F8];
                 state_.castling_rights &= ~BLACK_KINGSIDE;
             }
             break;
@@ -329,11 +305,15 @@ void Board::MakeMove(Move move)
             if(side == WHITE) 
             {
                 MovePiece(A1,D1,WHITE_ROOKS);
+                add_dirty_piece(dirty,WHITE_ROOKS,A1,D1);
+                hash ^= zobrist_table[WHITE_ROOKS][A1] ^ zobrist_table[WHITE_ROOKS][D1];
                 state_.castling_rights &= ~WHITE_QUEENSIDE;
             }
             else 
             {
                 MovePiece(A8,D8,BLACK_ROOKS);
+                add_dirty_piece(dirty,BLACK_ROOKS,A8,D8);
+                hash ^= zobrist_table[BLACK_ROOKS][A8] ^ zobrist_table[BLACK_ROOKS][D8];
                 state_.castling_rights &= ~BLACK_QUEENSIDE;
             }
             break;
@@ -341,16 +321,70 @@ void Board::MakeMove(Move move)
     }
 
     // Update pieces 
-    MovePiece(move.from,move.to);
+    if(move.capture) 
+    {
+        RemovePiece(move.captured_type,move.to);
+        add_dirty_piece(dirty,move.captured_type,move.to,SQUARE_NONE);
+        hash ^= zobrist_table[move.captured_type][move.to];
 
-    Bitboard to_bb = bb_from_square(move.to);
+        if(piece_of_type(move.captured_type,PAWNS))
+            state_.pawn_hash ^= zobrist_table[move.captured_type][move.to];
+    }
+
+    MovePiece(move.from,move.to,move.piece);
+    hash ^= zobrist_table[move.piece][move.from] ^ zobrist_table[move.piece][move.to];
+
+    if(piece_of_type(move.piece,PAWNS))
+    {
+        // A promoted pawn leaves the pawn structure.
+        state_.pawn_hash ^= zobrist_table[move.piece][move.from];
+        if(move.promotion == PIECE_TYPE_NONE)
+            state_.pawn_hash ^= zobrist_table[move.piece][move.to];
+    }
 
-    if(move.capture) pieces_[move.captured_type] &= ~to_bb;
     if(move.promotion != PIECE_TYPE_NONE) 
     {
-        pieces_[move.piece] &= ~to_bb;
-        pieces_[move.promotion] |= to_bb;
+        RemovePiece(move.piece,move.to);
+        AddPiece(move.promotion,move.to);
+        hash ^= zobrist_table[move.piece][move.to] ^ zobrist_table[move.promotion][move.to];
+
+        add_dirty_piece(dirty,move.piece,move.from,SQUARE_NONE);
+        add_dirty_piece(dirty,move.promotion,SQUARE_NONE,move.to);
     }
+    else
+        add_dirty_piece(dirty,move.piece,move.from,move.to);
+
+    // Moving the king or a rook, or capturing a 
+    // rook on its original square loses the castling rights.
+    state_.castling_rights &= castling_mask(move.from) & castling_mask(move.to);
+
+    state_.hash = hash ^ zobrist_castling[state_.castling_rights];
+}
+
+void Board::MakeNullMove()
+{
+    history_.push_back({state_,NULL_MOVE});
+    PushAccumulator();
+
+    if(state_.en_passant_square != SQUARE_NONE)
+    {
+        state_.hash ^= zobrist_en_passant[square_file(state_.en_passant_square)];
+        state_.en_passant_square = SQUARE_NONE;
+    }
+
+    state_.side_to_move = get_opposing_side(state_.side_to_move);
+    state_.hash ^= zobrist_side;
+
+    // The positions before a null move can't be 
+    // repeated in a game, so they're not looked at.
+    state_.half_moves = 0;
+}
+
+void Board::UndoNullMove()
+{
+    state_ = history_.back().state;
+    history_.pop_back();
+    PopAccumulator();
 }
 
 void Board::UndoMove()
@@ -362,6 +396,7 @@ void Board::UndoMove()
     Undo undo_info = history_.back();
     history_.pop_back();
     state_ = undo_info.state;
+    PopAccumulator();
 
     Move undo_move = undo_info.move; 
 
@@ -380,64 +415,27 @@ void Board::UndoMove()
             if(state_.side_to_move == WHITE) 
                 MovePiece(D1,A1,WHITE_ROOKS);
             else 
-                MovePiece(D8,A8,WHITE_ROOKS);
+                MovePiece(D8,A8,BLACK_ROOKS);
             break;
         }
     }
 
     // Update pieces 
-    Bitboard from = bb_from_square(undo_move.from);
-    Bitboard to = bb_from_square(undo_move.to);
-    Bitboard from_to_bb = from | to;
-    pieces_[undo_move.piece] ^= from_to_bb;
-
-    if(undo_move.capture) pieces_[undo_move.captured_type] |= to;
     if(undo_move.promotion != PIECE_TYPE_NONE) 
     {
-        pieces_[undo_move.piece] &= ~to;
-        pieces_[undo_move.promotion] &= ~to;
+        RemovePiece(undo_move.promotion,undo_move.to);
+        AddPiece(undo_move.piece,undo_move.to);
     }
+
+    MovePiece(undo_move.to,undo_move.from,undo_move.piece);
+
+    if(undo_move.capture) 
+        AddPiece(undo_move.captured_type,undo_move.to);
 }
 
 bool Board::SquareAttacked(Square square, Side side) const
 {
-    Bitboard square_bb = bb_from_square(square);
-
-    Side opponent = get_opposing_side(side);
-    Bitboard occupied_opponent = OccupiedBySide(opponent);
-    Bitboard occupied = GetOccupied();
-
-    // For each opponent piece, compare their attacks 
-    // to the square. Make a copy of the occupy mask 
-    // because we need the unmodified one inside the loop.
-    Bitboard opponent_squares = occupied_opponent;
-    while(opponent_squares)
-    {
-        Square piece_square = PopLSB(&opponent_squares);
-        PieceType piece = GetPieceOnSquare(piece_square);
-
-        Bitboard piece_square_bb = bb_from_square(piece_square);
-
-        Bitboard attacked_squares = 0ULL;
-        if(is_sliding_piece(piece))
-        {
-            if(piece == WHITE_BISHOPS || piece == BLACK_BISHOPS) 
-                attacked_squares = bishop_moves(occupied,piece_square);
-            else if(piece == WHITE_ROOKS || piece == BLACK_ROOKS)
-                attacked_squares = rook_moves(occupied,piece_square);
-            else if(piece == WHITE_QUEEN || piece == BLACK_QUEEN)
-                attacked_squares = queen_moves(occupied,piece_square);
-        }
-        else
-        {
-			int attacks_index = piece_type_to_attacks_index(piece);
-            attacked_squares = attacks[attacks_index][piece_square];
-        }
-
-        attacked_squares &= ~occupied_opponent;
-        if(attacked_squares & square_bb) return true;
-    }
-    return false;
+    return AttackersTo(square,get_opposing_side(side),GetOccupied()) != 0;
 }
 
 bool Board::InCheck(Side side) const
@@ -472,6 +470,17 @@ Bitboard Board::GetOccupied() const
     return occupied;
 }
 
+bool Board::HasNonPawnMaterial(Side side) const
+{
+    int start_piece = (side == WHITE)?WHITE_KNIGHTS:BLACK_KNIGHTS;
+    int end_piece = (side == WHITE)?WHITE_QUEEN:BLACK_QUEEN;
+    for(int curr_piece = start_piece; curr_piece <= end_piece; ++curr_piece)
+    {
+        if(pieces_[curr_piece]) return true;
+    }
+    return false;
+}
+
 PieceType Board::GetPieceOnSquare(Bitboard square) const
 {
 	for (int piece = WHITE_PAWNS; piece <= BLACK_KING; ++piece)
@@ -536,6 +545,302 @@ bool Board::CanCastle(Side side, Castling type) const
     return true;
 }
 
+Bitboard Board::AttackersTo(Square square, Side attacker, Bitboard occupied) const
+{
+    // A piece on the square attacks the same squares it is
+    // attacked from. Pawns use the attacks of the other color.
+    int first = (attacker == WHITE)?WHITE_PAWNS:BLACK_PAWNS;
+    PieceAttacks pawn_attacks = (attacker == WHITE)?ATTACKS_BLACK_PAWN:ATTACKS_WHITE_PAWN;
+
+    Bitboard queens = pieces_[first + QUEENS];
+    Bitboard diagonal = pieces_[first + BISHOPS] | queens;
+    Bitboard straight = pieces_[first + ROOKS] | queens;
+
+    return (attacks[pawn_attacks][square] & pieces_[first + PAWNS])
+         | (attacks[ATTACKS_KNIGHT][square] & pieces_[first + KNIGHTS])
+         | (attacks[ATTACKS_KING][square] & pieces_[first + KINGS])
+         | (diagonal ? bishop_moves(occupied,square) & diagonal : 0ULL)
+         | (straight ? rook_moves(occupied,square) & straight : 0ULL);
+}
+
+Bitboard Board::PseudoLegalTargets(PieceType piece, Square from) const
+{
+    Side side = state_.side_to_move;
+    Bitboard occupied = GetOccupied();
+    Bitboard targets = 0ULL;
+
+    switch(piece)
+    {
+        case WHITE_PAWNS:
+        case BLACK_PAWNS:
+        {
+            Bitboard from_bb = bb_from_square(from);
+            Bitboard second_rank = (side == WHITE)?kBitboardRank2:kBitboardRank7;
+
+            Bitboard single = ((side == WHITE)?from_bb << 8:from_bb >> 8) & ~occupied;
+            Bitboard double_push = 0ULL;
+            if(from_bb & second_rank)
+                double_push = ((side == WHITE)?single << 8:single >> 8) & ~occupied;
+
+            PieceAttacks pawn_attacks = (side == WHITE)?ATTACKS_WHITE_PAWN:ATTACKS_BLACK_PAWN;
+            Bitboard captures = attacks[pawn_attacks][from] & OccupiedBySide(get_opposing_side(side));
+
+            return single | double_push | captures;
+        }
+        case WHITE_KNIGHTS:
+        case BLACK_KNIGHTS: targets = attacks[ATTACKS_KNIGHT][from]; break;
+        case WHITE_BISHOPS:
+        case BLACK_BISHOPS: targets = bishop_moves(occupied,from); break;
+        case WHITE_ROOKS:
+        case BLACK_ROOKS:   targets = rook_moves(occupied,from); break;
+        case WHITE_QUEEN:
+        case BLACK_QUEEN:   targets = queen_moves(occupied,from); break;
+        case WHITE_KING:
+        case BLACK_KING:    targets = attacks[ATTACKS_KING][from]; break;
+        default:            return 0ULL;
+    }
+
+    return targets & ~OccupiedBySide(side);
+}
+
+Move Board::MoveFromSquares(Square from, Square to, PieceType promotion) const
+{
+    PieceType piece = GetPieceOnSquare(from);
+    PieceType captured = GetPieceOnSquare(to);
+
+    Move move = {from,to,piece,NORMAL,promotion,captured,captured != PIECE_TYPE_NONE};
+
+    // The king moves two squares only when castling.
+    if((piece == WHITE_KING || piece == BLACK_KING) && (to - from == 2 || from - to == 2))
+        move.type = (to > from)?CASTLE_KINGSIDE:CASTLE_QUEENSIDE;
+    else if(piece == WHITE_PAWNS || piece == BLACK_PAWNS)
+    {
+        if(bb_from_square(to) & (kBitboardRank1 | kBitboardRank8))
+            move.type = PROMOTION;
+        else if(to - from == 16 || from - to == 16)
+            move.type = DOUBLE_PAWN;
+    }
+
+    return move;
+}
+
+Move Board::UnpackMove(PackedMove packed) const
+{
+    if(packed == kPackedMoveNone)
+        return NULL_MOVE;
+
+    int promotion = packed >> 12;
+    return MoveFromSquares((Square)(packed & 63),(Square)((packed >> 6) & 63),
+                           promotion?(PieceType)(promotion - 1):PIECE_TYPE_NONE);
+}
+
+bool Board::IsPseudoLegal(const Move& move) const
+{
+    Side side = state_.side_to_move;
+
+    if(move.from >= NUM_SQUARES || move.to >= NUM_SQUARES)
+        return false;
+
+    if(!(OccupiedBySide(side) & bb_from_square(move.from)))
+        return false;
+
+    // The fields have to describe what is on the board.
+    Move expected = MoveFromSquares(move.from,move.to,move.promotion);
+    if(move.piece != expected.piece || move.type != expected.type 
+        || move.captured_type != expected.captured_type || move.capture != expected.capture)
+        return false;
+
+    if(move.type == PROMOTION)
+    {
+        PieceType first = piece_type_from_piece(KNIGHTS,side);
+        PieceType last = piece_type_from_piece(QUEENS,side);
+        if(move.promotion < first || move.promotion > last)
+            return false;
+    }
+    else if(move.promotion != PIECE_TYPE_NONE)
+        return false;
+
+    if(move.type == CASTLE_KINGSIDE || move.type == CASTLE_QUEENSIDE)
+    {
+        Square king = (side == WHITE)?E1:E8;
+        Castling castling = (move.type == CASTLE_KINGSIDE)
+            ?((side == WHITE)?WHITE_KINGSIDE:BLACK_KINGSIDE)
+            :((side == WHITE)?WHITE_QUEENSIDE:BLACK_QUEENSIDE);
+
+        return move.from == king && CanCastle(side,castling);
+    }
+
+    return (PseudoLegalTargets(move.piece,move.from) & bb_from_square(move.to)) != 0;
+}
+
+bool Board::IsLegal(const Move& move) const
+{
+    // CanCastle has already checked the squares the king crosses.
+    if(move.type == CASTLE_KINGSIDE || move.type == CASTLE_QUEENSIDE)
+        return true;
+
+    Side side = state_.side_to_move;
+    Bitboard from_bb = bb_from_square(move.from);
+    Bitboard to_bb = bb_from_square(move.to);
+
+    PieceType king = (side == WHITE)?WHITE_KING:BLACK_KING;
+    Square king_square = (move.piece == king)?move.to:square_from_bitboard(pieces_[king]);
+
+    // The occupancy after the move uncovers the sliders the moving
+    // piece was pinned by. A captured attacker no longer attacks.
+    Bitboard occupied = (GetOccupied() ^ from_bb) | to_bb;
+    return !(AttackersTo(king_square,get_opposing_side(side),occupied) & ~to_bb);
+}
+
+CheckInfo::CheckInfo(const Board& board)
+{
+    Side side = board.SideToMove();
+    Side opponent = get_opposing_side(side);
+    int first = (side == WHITE)?WHITE_PAWNS:BLACK_PAWNS;
+
+    king_square = square_from_bitboard(board.pieces_[(opponent == WHITE)?WHITE_KING:BLACK_KING]);
+
+    Bitboard occupied = board.GetOccupied();
+    Bitboard diagonal = bishop_moves(occupied,king_square);
+    Bitboard straight = rook_moves(occupied,king_square);
+
+    // A pawn of the side attacks the king from where a
+    // pawn of the opponent on the king's square would attack.
+    check_squares[PAWNS] = attacks[(side == WHITE)?ATTACKS_BLACK_PAWN:ATTACKS_WHITE_PAWN][king_square];
+    check_squares[KNIGHTS] = attacks[ATTACKS_KNIGHT][king_square];
+    check_squares[BISHOPS] = diagonal;
+    check_squares[ROOKS] = straight;
+    check_squares[QUEENS] = diagonal | straight;
+    check_squares[KINGS] = 0ULL;
+
+    // The sliders that would attack the king on an empty board.
+    Bitboard queens = board.pieces_[first + QUEENS];
+    Bitboard snipers = (bishop_moves(0ULL,king_square) & (board.pieces_[first + BISHOPS] | queens))
+                     | (rook_moves(0ULL,king_square) & (board.pieces_[first + ROOKS] | queens));
+
+    Bitboard king_bb = bb_from_square(king_square);
+    Bitboard own = board.OccupiedBySide(side);
+
+    discovered_candidates = 0ULL;
+    while(snipers)
+    {
+        Square sniper = PopLSB(&snipers);
+        Bitboard sniper_bb = bb_from_square(sniper);
+
+        // The rays from the two squares towards each other meet on
+        // the squares between them. The other rays don't cross.
+        Bitboard between = (bishop_moves(0ULL,king_square) & sniper_bb)
+            ? bishop_moves(sniper_bb,king_square) & bishop_moves(king_bb,sniper)
+            : rook_moves(sniper_bb,king_square) & rook_moves(king_bb,sniper);
+
+        Bitboard blockers = between & occupied;
+        if(PopulationCount(blockers) == 1 && (blockers & own))
+            discovered_candidates |= blockers;
+    }
+}
+
+bool Board::GivesCheck(const Move& move, const CheckInfo& info) const
+{
+    Side side = state_.side_to_move;
+    int first = (side == WHITE)?WHITE_PAWNS:BLACK_PAWNS;
+
+    Bitboard from_bb = bb_from_square(move.from);
+    Bitboard to_bb = bb_from_square(move.to);
+    Bitboard king_bb = bb_from_square(info.king_square);
+
+    if(move.type == CASTLE_KINGSIDE || move.type == CASTLE_QUEENSIDE)
+    {
+        // Only the rook can give check. The king moves out of its way.
+        bool kingside = move.type == CASTLE_KINGSIDE;
+        Square rook_from = (side == WHITE)?(kingside?H1:A1):(kingside?H8:A8);
+        Square rook_to = (side == WHITE)?(kingside?F1:D1):(kingside?F8:D8);
+
+        Bitboard occupied = GetOccupied() ^ from_bb ^ to_bb ^ bb_from_square(rook_from) ^ bb_from_square(rook_to);
+        return (rook_moves(occupied,rook_to) & king_bb) != 0;
+    }
+
+    Bitboard occupied = (GetOccupied() ^ from_bb) | to_bb;
+
+    if(move.type == PROMOTION)
+    {
+        // The pawn leaves its square, which may open the
+        // line from the new piece to the king.
+        Bitboard targets = 0ULL;
+        switch(move.promotion % NUM_PIECES)
+        {
+            case KNIGHTS: targets = attacks[ATTACKS_KNIGHT][move.to]; break;
+            case BISHOPS: targets = bishop_moves(occupied,move.to); break;
+            case ROOKS:   targets = rook_moves(occupied,move.to); break;
+            case QUEENS:  targets = queen_moves(occupied,move.to); break;
+            default: break;
+        }
+
+        if(targets & king_bb)
+            return true;
+    }
+    else if(info.check_squares[move.piece % NUM_PIECES] & to_bb)
+        return true;
+
+    if(!(info.discovered_candidates & from_bb))
+        return false;
+
+    // The piece may stay on the line to the king.
+    Bitboard queens = pieces_[first + QUEENS];
+    Bitboard sliders = (bishop_moves(occupied,info.king_square) & (pieces_[first + BISHOPS] | queens))
+                     | (rook_moves(occupied,info.king_square) & (pieces_[first + ROOKS] | queens));
+
+    return (sliders & ~from_bb) != 0;
+}
+
+bool Board::IsRepetition(int ply) const
+{
+    // Only the positions since the last capture or pawn move can
+    // repeat, and only every other one has the same side to move.
+    int reversible = std::min((int)state_.half_moves,(int)history_.size());
+    int repetitions = 0;
+
+    for(int i = 4; i <= reversible; i += 2)
+    {
+        if(history_[history_.size() - i].state.hash != state_.hash)
+            continue;
+
+        if(i <= ply || ++repetitions == 2)
+            return true;
+    }
+
+    return false;
+}
+
+bool Board::IsDraw(int ply) const
+{
+    if(IsRepetition(ply))
+        return true;
+
+    // Neither side can mate with a lone minor piece.
+    if(!(pieces_[WHITE_PAWNS] | pieces_[BLACK_PAWNS] 
+        | pieces_[WHITE_ROOKS] | pieces_[BLACK_ROOKS]
+        | pieces_[WHITE_QUEEN] | pieces_[BLACK_QUEEN])
+        && piece_count_[WHITE_KNIGHTS] + piece_count_[BLACK_KNIGHTS] 
+         + piece_count_[WHITE_BISHOPS] + piece_count_[BLACK_BISHOPS] <= 1)
+        return true;
+
+    if(state_.half_moves < 100)
+        return false;
+
+    // A mate on the hundredth ply still counts.
+    Side side = state_.side_to_move;
+    if(!InCheck(side))
+        return true;
+
+    std::vector<Move> moves;
+    if(side == WHITE)
+        move_generation::LegalAll<WHITE>(*this,&moves);
+    else
+        move_generation::LegalAll<BLACK>(*this,&moves);
+
+    return !moves.empty();
+}
+
 void Board::PrintPosition() const
 {
 	const char *files = "ABCDEFGH";
@@ -570,29 +875,73 @@ void Board::PrintState() const
 
 void Board::InitZobristHashing()
 {
+    std::uniform_int_distribution<u64> dist(0,UINT64_MAX);
+
     for(int piece_type = 0; piece_type < NUM_PIECE_TYPES; ++piece_type)  
     {
         for(int square = 0; square < NUM_SQUARES; ++square)
         {
-            std::uniform_int_distribution<u64> dist(0,UINT64_MAX);
             zobrist_table[piece_type][square] = dist(gen);
         }
     }
+
+    zobrist_side = dist(gen);
+
+    for(int rights = 0; rights < 16; ++rights)
+        zobrist_castling[rights] = dist(gen);
+
+    for(int file = FILE_A; file < NUM_FILES; ++file)
+        zobrist_en_passant[file] = dist(gen);
+
+    for(int piece_type = 0; piece_type < NUM_PIECE_TYPES; ++piece_type)  
+        for(int count = 0; count < NUM_SQUARES; ++count)
+            zobrist_material[piece_type][count] = dist(gen);
 }
 
 void Board::UpdateZobristHash()
 {
     state_.hash = 0ULL;
+    state_.pawn_hash = 0ULL;
     for(int square=0; square<NUM_SQUARES; ++square)
     {
-        int occupying_piece = GetPieceOnSquare(square);
+        int occupying_piece = GetPieceOnSquare((Square)square);
         if(occupying_piece != PIECE_TYPE_NONE)
             state_.hash ^= zobrist_table[occupying_piece][square];
+
+        if(occupying_piece == WHITE_PAWNS || occupying_piece == BLACK_PAWNS)
+            state_.pawn_hash ^= zobrist_table[occupying_piece][square];
+    }
+
+    if(state_.side_to_move == BLACK)
+        state_.hash ^= zobrist_side;
+
+    state_.hash ^= zobrist_castling[state_.castling_rights];
+
+    if(state_.en_passant_square != SQUARE_NONE)
+        state_.hash ^= zobrist_en_passant[square_file(state_.en_passant_square)];
+}
+
+void Board::UpdateMaterial()
+{
+    psq_ = {0, 0};
+    material_key_ = 0;
+
+    for(int piece = WHITE_PAWNS; piece < NUM_PIECE_TYPES; ++piece)
+    {
+        piece_count_[piece] = 0;
+
+        Bitboard bitboard = pieces_[piece];
+        while(bitboard)
+        {
+            Square square = PopLSB(&bitboard);
+            psq_ += evaluation::psq[piece][square];
+            material_key_ ^= zobrist_material[piece][piece_count_[piece]++];
+        }
     }
 }
 
-int Board::Evaluate()
+int Board::Evaluate() const
 {
-	return evaluation::evaluate(this);
+	return evaluation::evaluate(*this);
 }
 
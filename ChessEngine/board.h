@@ -3,13 +3,17 @@
 
 #include "types.h"
 #include "move.h"
+#include "nnue.h"
 
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct State
 {
     u64         hash;
+    u64         pawn_hash;  // Hash of the pawns only.
     Side        side_to_move;
     u8          castling_rights;
     unsigned    half_moves;
@@ -21,6 +25,26 @@ struct State
 	bool king_has_moved[NUM_SIDES] = {false, false};
 };
 
+class Board;
+
+// What is needed to tell whether a move gives check, computed once
+// per node for the side to move.
+struct CheckInfo
+{
+    explicit CheckInfo(const Board& board);
+
+    // The opponent's king.
+    Square king_square;
+
+    // The squares from which a piece of each kind would attack
+    // the king, indexed by Piece.
+    Bitboard check_squares[NUM_PIECES];
+
+    // Own pieces that are the only blocker between an own slider
+    // and the king. Moving one off the line is a discovered check.
+    Bitboard discovered_candidates;
+};
+
 // An element on the history stack.
 struct Undo
 {
@@ -38,10 +62,16 @@ public:
 
     static void InitZobristHashing();
 
-    // Updates the hash in state_
-    // to reflect the current position.
+    // Calculates the hash and the pawn hash in state_ 
+    // from scratch to reflect the current position. MakeMove 
+    // and UndoMove keep the hashes updated incrementally.
     void UpdateZobristHash();
 
+    // Calculates the piece-square score, the piece counts 
+    // and the material key from scratch. MakeMove, UndoMove 
+    // and MovePiece keep them updated incrementally.
+    void UpdateMaterial();
+
     // Resets the board to initial values.
     // The piece bitboards are reset to zero.
     void Reset();
@@ -58,8 +88,13 @@ public:
     void PrintState() const;
 
     // Sets the position according to the given fen string.
-	// Returns false if position could not be parsed.
-    bool SetPositionFromFEN(const std::string& fen_string);
+	// Returns false and leaves the board unchanged if the
+	// position could not be parsed.
+    bool SetPositionFromFEN(std::string_view fen_string);
+
+    // Same for an EPD line. operations is set to the
+    // operations that follow the position fields.
+    bool SetPositionFromEPD(std::string_view epd, std::string_view *operations);
 
 	// Generate FEN string from current position.
 	std::string GenerateFenString() const;
@@ -75,9 +110,32 @@ public:
 
     // Undoes the last move that was made.
     void UndoMove();
+
+    // Passes the turn to the opponent. Used by the
+    // null move pruning in the search.
+    void MakeNullMove();
+
+    // Undoes a move made with MakeNullMove.
+    void UndoNullMove();
     
-    // Returns a heuristic value for the current position.
-    int Evaluate();
+    // Returns a heuristic value for the current position in
+    // centipawns from the side to move's point of view.
+    int Evaluate() const;
+
+    // Sets the network of the NNUE evaluation, nullptr for the 
+    // classical evaluation. It is copied with the board.
+    void SetNetwork(std::shared_ptr<const nnue::Network> network);
+    const nnue::Network* GetNetwork() const {return network_.get();}
+
+    // Sum of the material and piece-square values 
+    // of the pieces from white's point of view.
+    Score PsqScore() const {return psq_;}
+
+    int PieceCount(PieceType piece) const {return piece_count_[piece];}
+
+    // Hash of the number of pieces of each type. Positions
+    // with the same material have the same key.
+    u64 MaterialKey() const {return material_key_;}
 
     // Returns true if the square for the given side is being attacked
     // by the opponent.
@@ -90,6 +148,46 @@ public:
     // given side and castling type.
     bool CanCastle(Side side, Castling type) const;
 
+    // Returns the pieces of the attacking side that attack the
+    // square when the squares in occupied are the occupied ones.
+    Bitboard AttackersTo(Square square, Side attacker, Bitboard occupied) const;
+
+    // Returns the squares the piece on the square can move to,
+    // castling not included. The own king may be left in check.
+    Bitboard PseudoLegalTargets(PieceType piece, Square from) const;
+
+    // Creates the move between the squares with the moving and
+    // captured pieces and the type taken from the board. The
+    // move isn't validated.
+    Move MoveFromSquares(Square from, Square to, PieceType promotion) const;
+
+    // Same for a move stored in the search tables.
+    Move UnpackMove(PackedMove packed) const;
+
+    // Returns true if the move could have been generated in this
+    // position, in constant time. Hash moves and killers come from
+    // other positions and have to be checked before they're played.
+    bool IsPseudoLegal(const Move& move) const;
+
+    // Returns true if the position occurred before since the last
+    // capture or pawn move. The root of the search is ply plies back.
+    // A position first seen after the root counts after one repetition,
+    // an earlier one after two (threefold repetition).
+    bool IsRepetition(int ply) const;
+
+    // Returns true if the position is drawn by repetition,
+    // the fifty move rule or insufficient material.
+    bool IsDraw(int ply) const;
+
+    // Returns true if the pseudo-legal move checks the opponent's
+    // king, directly or by uncovering a slider, without making it.
+    bool GivesCheck(const Move& move, const CheckInfo& info) const;
+
+    // Returns true if the pseudo-legal move doesn't leave the own
+    // king in check. The attacks on the king are looked up with the
+    // occupancy after the move, so the move isn't made.
+    bool IsLegal(const Move& move) const;
+
     // Returns a bitboard of the squares occupied 
     // by the given side.
     Bitboard OccupiedBySide(Side side) const; 
@@ -97,6 +195,9 @@ public:
     // Returns a bitboard of all the occupied squares.
     Bitboard GetOccupied() const;
 
+    // Returns true if the side has other pieces than pawns and the king.
+    bool HasNonPawnMaterial(Side side) const;
+
 	Side SideToMove() const {return state_.side_to_move;} 
 
     // Returns the enumeration of the piece that occupies the given square.
@@ -108,11 +209,41 @@ public:
 
     std::vector<Undo> history_;
 
+    // Accumulators of the NNUE evaluation, one for each move
+    // made since the position was set. Only the top one is
+    // copied with the board. They are computed lazily by the 
+    // evaluation, which is why they are mutable.
+    mutable std::vector<nnue::Accumulator> accumulators_;
+    size_t accumulator_top_;
+    std::shared_ptr<const nnue::Network> network_;
+
 private:
+    // Pushes an accumulator for the new ply. Its 
+    // dirty pieces are recorded by MakeMove.
+    nnue::DirtyPieces* PushAccumulator();
+    void PopAccumulator();
+
+    // Invalidates every accumulator after the position was set.
+    void ResetAccumulators();
+
+    void AddPiece(PieceType piece, Square square);
+    void RemovePiece(PieceType piece, Square square);
+
+    Score psq_;
+    int piece_count_[NUM_PIECE_TYPES];
+    u64 material_key_;
+
     // Used to calculate Zobrist hash key for a position.
     // InitZobristHashing() fills this with random numbers 
     // for each piece-square combination.
     static u64 zobrist_table[NUM_PIECE_TYPES][NUM_SQUARES];
+    static u64 zobrist_side;
+    static u64 zobrist_castling[16];
+    static u64 zobrist_en_passant[NUM_FILES];
+
+    // Indexed by the number of pieces of the 
+    // type on the board before the piece was added.
+    static u64 zobrist_material[NUM_PIECE_TYPES][NUM_SQUARES];
 };
 
 #endif //BOARD_H_
@@ -0,0 +1,117 @@
+#include "chess_engine.h"
+#include "engine.h"
+#include "move_generation.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+struct ce_session
+{
+    Engine engine;
+};
+
+namespace
+{
+    void copy_move(const Move& move, ce_move out)
+    {
+        std::string uci = move_to_uci(move);
+        std::strncpy(out, uci.c_str(), CE_MOVE_SIZE - 1);
+        out[CE_MOVE_SIZE - 1] = '\0';
+    }
+}
+
+ce_session *ce_session_create(void)
+{
+    ce_session *session = new (std::nothrow) ce_session;
+    if(session)
+        session->engine.search.silent = true;
+
+    return session;
+}
+
+void ce_session_destroy(ce_session *session)
+{
+    delete session;
+}
+
+int ce_set_option(ce_session *session, const char *name, const char *value)
+{
+    std::string error;
+    return session->engine.SetOption(name, value?value:"", &error)?0:-1;
+}
+
+int ce_set_position(ce_session *session, const char *fen, const char *const *moves, int num_moves)
+{
+    std::vector<std::string> move_list(moves, moves + num_moves);
+    return session->engine.SetPosition(fen?fen:kFenStartPosition, move_list)?0:-1;
+}
+
+int ce_legal_moves(ce_session *session, ce_move *moves, int capacity)
+{
+    const Board& board = session->engine.board;
+
+    std::vector<Move> move_list;
+    if(board.SideToMove() == WHITE)
+        move_generation::LegalAll<WHITE>(board, &move_list);
+    else
+        move_generation::LegalAll<BLACK>(board, &move_list);
+
+    int count = std::min((int)move_list.size(), capacity);
+    for(int i = 0; i < count; ++i)
+        copy_move(move_list[i], moves[i]);
+
+    return count;
+}
+
+int ce_evaluate(ce_session *session)
+{
+    return session->engine.board.Evaluate();
+}
+
+int ce_search(ce_session *session, const ce_limits *limits,
+              ce_info_callback callback, void *user_data, ce_move best_move)
+{
+    Engine& engine = session->engine;
+    Search& search = engine.search;
+
+    engine.Stop();
+    engine.Wait();
+
+    search.depth = limits?limits->depth:0;
+    search.nodes = (limits && limits->nodes > 0)?(u64)limits->nodes:0;
+    search.duration = limits?limits->movetime:0;
+    search.infinite = false;
+
+    // Storage of the principal variation passed to the callback.
+    std::vector<char> pv_buffer;
+    if(callback)
+    {
+        search.info_callback = [&pv_buffer, callback, user_data](const SearchInfo& info){
+            pv_buffer.resize(info.pv_length * CE_MOVE_SIZE);
+            ce_move *pv = reinterpret_cast<ce_move*>(pv_buffer.data());
+
+            for(int i = 0; i < info.pv_length; ++i)
+                copy_move(info.pv[i], pv[i]);
+
+            ce_info c_info = {info.depth, info.multipv, info.score, info.mate, info.nodes,
+                info.nps, info.time, pv, info.pv_length};
+            callback(&c_info, user_data);
+        };
+    }
+
+    engine.Go();
+    engine.Wait();
+
+    search.info_callback = nullptr;
+
+    copy_move(search.best_move, best_move);
+    return search.best_eval;
+}
+
+void ce_stop(ce_session *session)
+{
+    session->engine.Stop();
+}
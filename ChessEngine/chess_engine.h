@@ -0,0 +1,80 @@
+#ifndef CHESS_ENGINE_H_
+#define CHESS_ENGINE_H_
+
+/* C API of the engine for in-process use. Build the library with
+ * make lib, which produces libchessengine.a and libchessengine.so.
+ *
+ * Every session is independent and can be used from its own thread.
+ * A single session must not be used from several threads at once. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ce_session ce_session;
+
+/* Moves are in UCI notation, for example e2e4 or e7e8q. */
+#define CE_MOVE_SIZE 6
+typedef char ce_move[CE_MOVE_SIZE];
+
+/* Search limits. A zero field is not a limit. */
+typedef struct ce_limits
+{
+    int depth;
+    int64_t nodes;  /* a negative count is not a limit either */
+    int movetime;   /* in milliseconds */
+} ce_limits;
+
+/* Progress of the search after each completed iteration, for
+ * each line when the MultiPV option is above 1. */
+typedef struct ce_info
+{
+    int depth;
+    int multipv;    /* 1 for the best line */
+    int score;      /* centipawns, or moves to mate if mate is set */
+    int mate;
+    uint64_t nodes;
+    uint64_t nps;
+    int time;       /* in milliseconds */
+    const ce_move *pv;
+    int pv_length;
+} ce_info;
+
+typedef void (*ce_info_callback)(const ce_info *info, void *user_data);
+
+/* Returns NULL if the session couldn't be created. */
+ce_session *ce_session_create(void);
+void ce_session_destroy(ce_session *session);
+
+/* Sets a UCI option such as Hash or Threads. Returns 0 on success. */
+int ce_set_option(ce_session *session, const char *name, const char *value);
+
+/* Sets the position from a FEN string, or the start position if fen
+ * is NULL, and plays the moves. Returns 0 on success and -1 if the FEN
+ * string or a move is invalid. */
+int ce_set_position(ce_session *session, const char *fen, const char *const *moves, int num_moves);
+
+/* Writes the legal moves of the position to moves and returns their
+ * number. At most capacity moves are written. */
+int ce_legal_moves(ce_session *session, ce_move *moves, int capacity);
+
+/* Static evaluation in centipawns from the side to move's point of view. */
+int ce_evaluate(ce_session *session);
+
+/* Searches the position until a limit is reached or ce_stop is called.
+ * The callback is called after each iteration if it's not NULL. Writes
+ * the best move to best_move and returns the score in centipawns.
+ * Blocks until the search has finished. */
+int ce_search(ce_session *session, const ce_limits *limits,
+              ce_info_callback callback, void *user_data, ce_move best_move);
+
+/* Stops the search of the session. Can be called from any thread. */
+void ce_stop(ce_session *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHESS_ENGINE_H_ */
@@ -0,0 +1,173 @@
+#include "engine.h"
+#include "bitboards.h"
+#include "move_generation.h"
+#include "evaluate.h"
+#include "nnue.h"
+#include "output.h"
+#include "util.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+    const int kMaxHashMB = 65536;
+}
+
+Engine::Engine()
+{
+    InitTables();
+    RegisterOptions();
+    board.SetPositionFromFEN(kFenStartPosition);
+}
+
+void Engine::InitTables()
+{
+    static std::once_flag initialized;
+
+    std::call_once(initialized, []{
+        init_bitboards();
+        evaluation::init();
+        Board::InitZobristHashing();
+        move_generation::Init();
+    });
+}
+
+bool Engine::SetPosition(const std::string& fen, const std::vector<std::string>& moves)
+{
+    // A GUI sends the whole game with every move. When the moves
+    // continue the previous position only the new ones are played.
+    size_t played = position_moves_.size();
+    bool extends = fen == position_fen_ && moves.size() >= played &&
+                   board.state_.hash == position_hash_ &&
+                   board.history_.size() == played &&
+                   std::equal(position_moves_.begin(), position_moves_.end(), moves.begin());
+
+    if(!extends)
+    {
+        played = 0;
+        position_moves_.clear();
+
+        if(!board.SetPositionFromFEN(fen))
+        {
+            board.SetPositionFromFEN(kFenStartPosition);
+            position_fen_.clear();
+            return false;
+        }
+
+        position_fen_ = fen;
+    }
+
+    for(size_t i = played; i < moves.size(); ++i)
+    {
+        if(!PlayMove(moves[i]))
+        {
+            // The board no longer matches a full move list.
+            position_fen_.clear();
+            return false;
+        }
+
+        position_moves_.push_back(moves[i]);
+    }
+
+    position_hash_ = board.state_.hash;
+    return true;
+}
+
+bool Engine::PlayMove(const std::string& uci_move)
+{
+    Move move = move_from_uci(board, uci_move);
+
+    if(move.type == MOVE_TYPE_NONE || !board.IsLegal(move))
+        return false;
+
+    board.MakeMove(move);
+    return true;
+}
+
+void Engine::UpdateNetwork()
+{
+    std::shared_ptr<const nnue::Network> network = use_nnue_?network_:nullptr;
+
+    board.SetNetwork(network);
+    search.network = network;
+    ClearEvaluationCaches(&search);
+}
+
+void Engine::NewGame()
+{
+    WaitForSearchFinished(&search);
+    search.transposition_table.Clear();
+}
+
+void Engine::Go()
+{
+    // Finish the previous search before
+    // changing the limits it's reading.
+    TerminateSearch(&search, true);
+    WaitForSearchFinished(&search);
+
+    StartSearch(&search, board);
+}
+
+void Engine::Stop()
+{
+    TerminateSearch(&search, true);
+}
+
+void Engine::Wait()
+{
+    WaitForSearchFinished(&search);
+}
+
+bool Engine::SetOption(const std::string& name, const std::string& value, std::string *error)
+{
+    return options.Set(name, value, error);
+}
+
+void Engine::RegisterOptions()
+{
+    Search *search = &this->search;
+
+    options.AddSpin("Hash", kDefaultTTSize, 1, kMaxHashMB, [search](const Option& option){
+        WaitForSearchFinished(search);
+        search->transposition_table.SetSize(option.IntValue());
+    });
+
+    options.AddSpin("Threads", 1, 1, kMaxThreads, [search](const Option& option){
+        SetThreadCount(search, option.IntValue());
+    });
+
+    options.AddSpin("MultiPV", 1, 1, kMaxMultiPV, [search](const Option& option){
+        WaitForSearchFinished(search);
+        search->multi_pv = option.IntValue();
+    });
+
+    // Tells the GUI that the engine can ponder. The
+    // GUI decides when to send "go ponder".
+    options.AddCheck("Ponder", false, [](const Option&){});
+
+    options.AddSpin("Move Overhead", kDefaultMoveOverhead, 0, 5000, [search](const Option& option){
+        WaitForSearchFinished(search);
+        search->move_overhead = option.IntValue();
+    });
+
+    options.AddCheck("Use NNUE", false, [this](const Option& option){
+        WaitForSearchFinished(&this->search);
+        use_nnue_ = option.BoolValue();
+        UpdateNetwork();
+    });
+
+    // The previous network is kept if the file can't be loaded.
+    options.AddString("EvalFile", "", [this](const Option& option){
+        WaitForSearchFinished(&this->search);
+        if(auto network = nnue::load(option.value))
+        {
+            network_ = network;
+            output::write_line("info string Loaded the network " + option.value);
+        }
+        else
+            output::write_line("info string Failed to load the network " + option.value);
+        UpdateNetwork();
+    });
+}
@@ -0,0 +1,82 @@
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include "board.h"
+#include "search.h"
+#include "options.h"
+
+#include <string>
+#include <vector>
+
+const std::string kFenStartPosition = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// An independent engine session: a board, the search with its
+// threads and transposition table, the NNUE network and the 
+// options that control them. A process can host any number of
+// sessions. They share only the precomputed tables (attacks, 
+// magics, Zobrist keys, piece-square tables), which are not 
+// modified after they are initialized.
+class Engine
+{
+public:
+    Engine();
+
+    // Initializes the shared tables. Safe to call from any
+    // thread, only the first call does the work. Called by
+    // the constructor.
+    static void InitTables();
+
+    // Sets the position from a FEN string and plays the moves in
+    // UCI notation. Returns false if the FEN string is invalid, in 
+    // which case the start position is set, or if a move is illegal, 
+    // in which case the moves before it are kept. If the FEN string
+    // is the same as in the previous call and the moves extend the
+    // previous moves, only the new moves are played.
+    bool SetPosition(const std::string& fen, const std::vector<std::string>& moves);
+
+    // Clears the state that belongs to the previous game.
+    void NewGame();
+
+    // Starts searching the current position with the limits
+    // set in search and returns immediately.
+    void Go();
+
+    void Stop();
+
+    // Blocks until the search has finished.
+    void Wait();
+
+    // Sets an option by its UCI name. Returns false and
+    // sets error if the option or the value is invalid.
+    bool SetOption(const std::string& name, const std::string& value, std::string *error);
+
+    Board board;
+    Search search;
+    Options options;
+
+private:
+    // Registers the options advertised in the response to the uci command.
+    // The options that touch the search are applied only between searches.
+    void RegisterOptions();
+
+    // Plays a move in UCI notation. Returns false
+    // if the move is illegal.
+    bool PlayMove(const std::string& uci_move);
+
+    // Gives the board and the search the loaded network if
+    // NNUE is enabled. Called between searches.
+    void UpdateNetwork();
+
+    // The arguments of the last successful SetPosition and
+    // the hash of the position it set. The board is public,
+    // so the hash tells whether it was changed since.
+    std::string position_fen_;
+    std::vector<std::string> position_moves_;
+    u64 position_hash_ = 0;
+
+    // Set by the EvalFile and Use NNUE options.
+    std::shared_ptr<const nnue::Network> network_;
+    bool use_nnue_ = false;
+};
+
+#endif // ENGINE_H_
@@ -1,32 +1,481 @@
 #include "evaluate.h"
 #include "bitboards.h"
+#include "attacks.h"
+#include "magic_bitboards.h"
+#include "util.h"
+#include "nnue.h"
 
-#define TERM(score,white_piece,black_piece) \
-(score * (PopulationCount(board->pieces_[white_piece]) - PopulationCount(board->pieces_[black_piece])))
+#include <algorithm>
+
+EvalCache::EvalCache(int size)
+	: entries_(size)
+{
+	Clear();
+}
+
+void EvalCache::Clear()
+{
+	// A zeroed entry only matches a hash whose upper 48 bits 
+	// are all zero, which is rare enough to be ignored.
+	std::fill(entries_.begin(), entries_.end(), 0);
+}
 
 namespace evaluation
 {
 
-float evaluate(Board *board)
+Score psq[NUM_PIECE_TYPES][NUM_SQUARES];
+
+// The first entry is A8 like in the Square enum. The 
+// black tables are the same tables mirrored vertically.
+const int kMiddlegameTables[NUM_PIECES][NUM_SQUARES] =
+{
+	{ // Pawns
+		  0,   0,   0,   0,   0,   0,   0,   0,
+		 98, 134,  61,  95,  68, 126,  34, -11,
+		 -6,   7,  26,  31,  65,  56,  25, -20,
+		-14,  13,   6,  21,  23,  12,  17, -23,
+		-27,  -2,  -5,  12,  17,   6,  10, -25,
+		-26,  -4,  -4, -10,   3,   3,  33, -12,
+		-35,  -1, -20, -23, -15,  24,  38, -22,
+		  0,   0,   0,   0,   0,   0,   0,   0
+	},
+	{ // Knights
+		-167, -89, -34, -49,  61, -97, -15, -107,
+		 -73, -41,  72,  36,  23,  62,   7,  -17,
+		 -47,  60,  37,  65,  84, 129,  73,   44,
+		  -9,  17,  19,  53,  37,  69,  18,   22,
+		 -13,   4,  16,  13,  28,  19,  21,   -8,
+		 -23,  -9,  12,  10,  19,  17,  25,  -16,
+		 -29, -53, -12,  -3,  -1,  18, -14,  -19,
+		-105, -21, -58, -33, -17, -28, -19,  -23
+	},
+	{ // Bishops
+		-29,   4, -82, -37, -25, -42,   7,  -8,
+		-26,  16, -18, -13,  30,  59,  18, -47,
+		-16,  37,  43,  40,  35,  50,  37,  -2,
+		 -4,   5,  19,  50,  37,  37,   7,  -2,
+		 -6,  13,  13,  26,  34,  12,  10,   4,
+		  0,  15,  15,  15,  14,  27,  18,  10,
+		  4,  15,  16,   0,   7,  21,  33,   1,
+		-33,  -3, -14, -21, -13, -12, -39, -21
+	},
+	{ // Rooks
+		 32,  42,  32,  51,  63,   9,  31,  43,
+		 27,  32,  58,  62,  80,  67,  26,  44,
+		 -5,  19,  26,  36,  17,  45,  61,  16,
+		-24, -11,   7,  26,  24,  35,  -8, -20,
+		-36, -26, -12,  -1,   9,  -7,   6, -23,
+		-45, -25, -16, -17,   3,   0,  -5, -33,
+		-44, -16, -20,  -9,  -1,  11,  -6, -71,
+		-19, -13,   1,  17,  16,   7, -37, -26
+	},
+	{ // Queens
+		-28,   0,  29,  12,  59,  44,  43,  45,
+		-24, -39,  -5,   1, -16,  57,  28,  54,
+		-13, -17,   7,   8,  29,  56,  47,  57,
+		-27, -27, -16, -16,  -1,  17,  -2,   1,
+		 -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+		-14,   2, -11,  -2,  -5,   2,  14,   5,
+		-35,  -8,  11,   2,   8,  15,  -3,   1,
+		 -1, -18,  -9,  10, -15, -25, -31, -50
+	},
+	{ // Kings
+		-65,  23,  16, -15, -56, -34,   2,  13,
+		 29,  -1, -20,  -7,  -8,  -4, -38, -29,
+		 -9,  24,   2, -16, -20,   6,  22, -22,
+		-17, -20, -12, -27, -30, -25, -14, -36,
+		-49,  -1, -27, -39, -46, -44, -33, -51,
+		-14, -14, -22, -46, -44, -30, -15, -27,
+		  1,   7,  -8, -64, -43, -16,   9,   8,
+		-15,  36,  12, -54,   8, -28,  24,  14
+	}
+};
+
+const int kEndgameTables[NUM_PIECES][NUM_SQUARES] =
+{
+	{ // Pawns
+		  0,   0,   0,   0,   0,   0,   0,   0,
+		178, 173, 158, 134, 147, 132, 165, 187,
+		 94, 100,  85,  67,  56,  53,  82,  84,
+		 32,  24,  13,   5,  -2,   4,  17,  17,
+		 13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+		  4,   7,  -6,   1,   0,  -5,  -1,  -8,
+		 13,   8,   8,  10,  13,   0,   2,  -7,
+		  0,   0,   0,   0,   0,   0,   0,   0
+	},
+	{ // Knights
+		-58, -38, -13, -28, -31, -27, -63, -99,
+		-25,  -8, -25,  -2,  -9, -25, -24, -52,
+		-24, -20,  10,   9,  -1,  -9, -19, -41,
+		-17,   3,  22,  22,  22,  11,   8, -18,
+		-18,  -6,  16,  25,  16,  17,   4, -18,
+		-23,  -3,  -1,  15,  10,  -3, -20, -22,
+		-42, -20, -10,  -5,  -2, -20, -23, -44,
+		-29, -51, -23, -15, -22, -18, -50, -64
+	},
+	{ // Bishops
+		-14, -21, -11,  -8,  -7,  -9, -17, -24,
+		 -8,  -4,   7, -12,  -3, -13,  -4, -14,
+		  2,  -8,   0,  -1,  -2,   6,   0,   4,
+		 -3,   9,  12,   9,  14,  10,   3,   2,
+		 -6,   3,  13,  19,   7,  10,  -3,  -9,
+		-12,  -3,   8,  10,  13,   3,  -7, -15,
+		-14, -18,  -7,  -1,   4,  -9, -15, -27,
+		-23,  -9, -23,  -5,  -9, -16,  -5, -17
+	},
+	{ // Rooks
+		 13,  10,  18,  15,  12,  12,   8,   5,
+		 11,  13,  13,  11,  -3,   3,   8,   3,
+		  7,   7,   7,   5,   4,  -3,  -5,  -3,
+		  4,   3,  13,   1,   2,   1,  -1,   2,
+		  3,   5,   8,   4,  -5,  -6,  -8, -11,
+		 -4,   0,  -5,  -1,  -7, -12,  -8, -16,
+		 -6,  -6,   0,   2,  -9,  -9, -11,  -3,
+		 -9,   2,   3,  -1,  -5, -13,   4, -20
+	},
+	{ // Queens
+		 -9,  22,  22,  27,  27,  19,  10,  20,
+		-17,  20,  32,  41,  58,  25,  30,   0,
+		-20,   6,   9,  49,  47,  35,  19,   9,
+		  3,  22,  24,  45,  57,  40,  57,  36,
+		-18,  28,  19,  47,  31,  34,  39,  23,
+		-16, -27,  15,   6,   9,  17,  10,   5,
+		-22, -23, -30, -16, -16, -23, -36, -32,
+		-33, -28, -22, -43,  -5, -32, -20, -41
+	},
+	{ // Kings
+		-74, -35, -18, -18, -11,  15,   4, -17,
+		-12,  17,  14,  17,  17,  38,  23,  11,
+		 10,  17,  23,  15,  20,  45,  44,  13,
+		 -8,  22,  24,  27,  26,  33,  26,   3,
+		-18,  -4,  21,  24,  27,  23,   9, -11,
+		-19,  -3,  11,  21,  23,  16,   7,  -9,
+		-27, -11,   4,  13,  14,   4,  -5, -17,
+		-53, -34, -21, -11, -28, -14, -24, -43
+	}
+};
+
+namespace
 {
-	//TODO Improve evaluation
-	int evaluation = 0;
+	// Attack weight per attacked square in the enemy king zone.
+	const int kKingAttackWeight[NUM_PIECES] = {0, 2, 2, 3, 5, 0};
+	const int kMaxKingDanger = 500;
+
+	// Attack bitboards gathered while evaluating the pieces 
+	// of each side and reused by the king safety and threats.
+	struct EvalInfo
+	{
+		Bitboard occupied;
+		Bitboard attacked_by[NUM_SIDES][NUM_PIECES];
+		Bitboard attacked[NUM_SIDES];
+		Bitboard mobility_area[NUM_SIDES];
+		Bitboard king_zone[NUM_SIDES];
+
+		// Pieces of the side that attack the enemy king 
+		// zone and the total weight of those attacks.
+		int king_attackers[NUM_SIDES];
+		int king_attack_weight[NUM_SIDES];
+
+		// Counts the terms for the tuner if set.
+		EvalTrace *trace;
+	};
+
+	inline Bitboard pieces(const Board& board, Side side, Piece piece)
+	{
+		return board.pieces_[side * NUM_PIECES + piece];
+	}
+
+	inline Bitboard file_of(Square square)
+	{
+		return kBitboardFileA >> (square % NUM_FILES);
+	}
+
+	void init_eval_info(const Board& board, const PawnEntry& pawn_entry, EvalInfo *info)
+	{
+		info->occupied = board.GetOccupied();
+
+		for(int side = WHITE; side < NUM_SIDES; ++side)
+		{
+			Side opponent = get_opposing_side((Side)side);
+			Square king_square = square_from_bitboard(pieces(board, (Side)side, KINGS));
+			Bitboard king_attacks = attacks[ATTACKS_KING][king_square];
+
+			info->attacked_by[side][PAWNS] = pawn_entry.pawn_attacks[side];
+			info->attacked_by[side][KINGS] = king_attacks;
+			info->attacked[side] = pawn_entry.pawn_attacks[side] | king_attacks;
+
+			info->king_zone[side] = king_attacks | bb_from_square(king_square);
+
+			// Squares not attacked by enemy pawns that aren't
+			// blocked by the side's own pawns or king.
+			info->mobility_area[side] = ~(pieces(board, (Side)side, PAWNS) 
+				| pieces(board, (Side)side, KINGS) 
+				| pawn_entry.pawn_attacks[opponent]);
+
+			info->king_attackers[side] = 0;
+			info->king_attack_weight[side] = 0;
+		}
+
+		info->trace = nullptr;
+	}
+
+	// Evaluates the mobility, the king zone attacks and the 
+	// rook files of the side's pieces in a single pass. The 
+	// attacks are stored in info for the other terms.
+	template <Side side>
+	Score evaluate_pieces(const Board& board, EvalInfo *info)
+	{
+		const Side opponent = (side == WHITE)?BLACK:WHITE;
+
+		Bitboard own_pawns = pieces(board, side, PAWNS);
+		Bitboard all_pawns = own_pawns | pieces(board, opponent, PAWNS);
+
+		const int sign = (side == WHITE)?1:-1;
+		EvalTrace *trace = info->trace;
+
+		Score score = {0, 0};
+
+		for(int piece = KNIGHTS; piece <= QUEENS; ++piece)
+		{
+			Bitboard bitboard = pieces(board, side, (Piece)piece);
+			info->attacked_by[side][piece] = 0;
+
+			while(bitboard)
+			{
+				Square square = PopLSB(&bitboard);
+
+				Bitboard piece_attacks;
+				switch(piece)
+				{
+					case KNIGHTS: piece_attacks = attacks[ATTACKS_KNIGHT][square]; break;
+					case BISHOPS: piece_attacks = magic_bitboards::bishop_moves(info->occupied, square); break;
+					case ROOKS:   piece_attacks = magic_bitboards::rook_moves(info->occupied, square); break;
+					default:      piece_attacks = magic_bitboards::queen_moves(info->occupied, square); break;
+				}
+
+				info->attacked_by[side][piece] |= piece_attacks;
+
+				int mobility = PopulationCount(piece_attacks & info->mobility_area[side]);
+				score += kMobilityWeight[piece] * (mobility - kMobilityCenter[piece]);
+
+				if(trace)
+					trace->mobility[piece] += sign * (mobility - kMobilityCenter[piece]);
+
+				Bitboard king_attacks = piece_attacks & info->king_zone[opponent];
+				if(king_attacks)
+				{
+					++info->king_attackers[side];
+					info->king_attack_weight[side] += kKingAttackWeight[piece] * PopulationCount(king_attacks);
+				}
+
+				if(piece == ROOKS)
+				{
+					Bitboard file = file_of(square);
+					if(!(file & all_pawns))
+					{
+						score += kRookOnOpenFile;
+						if(trace) trace->rook_on_open_file += sign;
+					}
+					else if(!(file & own_pawns))
+					{
+						score += kRookOnSemiOpenFile;
+						if(trace) trace->rook_on_semi_open_file += sign;
+					}
+				}
+			}
+
+			info->attacked[side] |= info->attacked_by[side][piece];
+		}
+
+		return score;
+	}
+
+	// Penalty for the enemy pieces attacking the side's king zone.
+	// A single attacker is not considered dangerous.
+	template <Side side>
+	Score evaluate_king_danger(const EvalInfo& info)
+	{
+		const Side opponent = (side == WHITE)?BLACK:WHITE;
+
+		if(info.king_attackers[opponent] < 2)
+			return {0, 0};
 
-	int material_score =
-		TERM(kPawnScore, WHITE_PAWNS, BLACK_PAWNS) +
-		TERM(kKnightScore, WHITE_KNIGHTS, BLACK_KNIGHTS) +
-		TERM(kBishopScore, WHITE_BISHOPS, BLACK_BISHOPS) +
-		TERM(kRookScore, WHITE_ROOKS, BLACK_ROOKS) +
-		TERM(kQueenScore, WHITE_QUEEN, BLACK_QUEEN);
+		int weight = info.king_attack_weight[opponent];
+		int danger = std::min(weight * weight / 8, kMaxKingDanger);
 
-	evaluation += material_score / 100;
+		return {-danger, -danger / 8};
+	}
 
-	return evaluation;
+	// Bonus for the side's attacks on enemy pieces that are 
+	// undefended or worth more than the attacker.
+	template <Side side>
+	Score evaluate_threats(const Board& board, const EvalInfo& info)
+	{
+		const Side opponent = (side == WHITE)?BLACK:WHITE;
+
+		Bitboard minors = pieces(board, opponent, KNIGHTS) | pieces(board, opponent, BISHOPS);
+		Bitboard rooks = pieces(board, opponent, ROOKS);
+		Bitboard queens = pieces(board, opponent, QUEENS);
+		Bitboard non_pawns = minors | rooks | queens;
+
+		Bitboard by_minors = info.attacked_by[side][KNIGHTS] | info.attacked_by[side][BISHOPS];
+
+		Bitboard hanging = (non_pawns | pieces(board, opponent, PAWNS)) 
+			& info.attacked[side] & ~info.attacked[opponent];
+
+		int by_pawn = PopulationCount(non_pawns & info.attacked_by[side][PAWNS]);
+		int by_minor = PopulationCount((rooks | queens) & by_minors);
+		int by_rook = PopulationCount(queens & info.attacked_by[side][ROOKS]);
+		int num_hanging = PopulationCount(hanging);
+
+		if(info.trace)
+		{
+			const int sign = (side == WHITE)?1:-1;
+			info.trace->threat_by_pawn += sign * by_pawn;
+			info.trace->threat_by_minor += sign * by_minor;
+			info.trace->threat_by_rook += sign * by_rook;
+			info.trace->hanging_piece += sign * num_hanging;
+		}
+
+		return kThreatByPawn * by_pawn + kThreatByMinor * by_minor
+			 + kThreatByRook * by_rook + kHangingPiece * num_hanging;
+	}
+
+	// Interpolates between the middlegame and endgame scores.
+	inline int taper(Score score, int phase)
+	{
+		return (score.mg * phase + score.eg * (kMaxPhase - phase)) / kMaxPhase;
+	}
+
+	// Counts the material and the piece-square terms.
+	void trace_pieces(const Board& board, EvalTrace *trace)
+	{
+		for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+		{
+			for(int side = WHITE; side < NUM_SIDES; ++side)
+			{
+				const int sign = (side == WHITE)?1:-1;
+				Bitboard bitboard = pieces(board, (Side)side, (Piece)piece);
+
+				while(bitboard)
+				{
+					Square square = PopLSB(&bitboard);
+					int table_square = (side == WHITE)?square:(square ^ 56);
+
+					trace->material[piece] += sign;
+					trace->psq[piece][table_square] += sign;
+				}
+			}
+		}
+	}
+
+	int evaluate_classical(const Board& board, PawnTable *pawn_table, 
+		MaterialTable *material_table, EvalTrace *trace)
+	{
+		MaterialEntry local_material;
+		MaterialEntry *material_entry = &local_material;
+
+		if(material_table)
+			material_entry = material_table->Probe(board);
+		else
+			material::evaluate_material(board, &local_material);
+
+		Side side = board.SideToMove();
+
+		if(trace)
+		{
+			*trace = EvalTrace();
+			trace->linear = !material_entry->draw && !material_entry->endgame;
+		}
+
+		if(material_entry->draw)
+			return kDrawScore;
+
+		if(material_entry->endgame)
+		{
+			int score = material_entry->endgame(board, material_entry->strong_side);
+			return (side == material_entry->strong_side)?score:-score;
+		}
+
+		if(board.GetNetwork() && !trace)
+			return nnue::evaluate(*board.GetNetwork(), board);
+
+		PawnEntry local_pawns;
+		PawnEntry *pawn_entry = &local_pawns;
+
+		if(pawn_table)
+			pawn_entry = pawn_table->Probe(board);
+		else
+			pawns::evaluate_pawn_structure(board, &local_pawns);
+
+		Score total = board.PsqScore() 
+			+ material_entry->imbalance
+			+ pawn_entry->score
+			+ pawn_entry->KingShield(board, WHITE) 
+			- pawn_entry->KingShield(board, BLACK);
+
+		EvalInfo info;
+		init_eval_info(board, *pawn_entry, &info);
+		info.trace = trace;
+
+		if(trace)
+			trace_pieces(board, trace);
+
+		total += evaluate_pieces<WHITE>(board, &info) - evaluate_pieces<BLACK>(board, &info);
+
+		// These need the attacks of both sides.
+		total += evaluate_king_danger<WHITE>(info) - evaluate_king_danger<BLACK>(info);
+		total += evaluate_threats<WHITE>(board, info) - evaluate_threats<BLACK>(board, info);
+
+		// Scale down the endgame score of the side that is ahead
+		// when its material advantage may not be enough to win.
+		Side strong_side = (total.eg > 0)?WHITE:BLACK;
+		int scale = material_entry->scale[strong_side];
+
+		if(material_entry->scale_function)
+			scale = std::min(scale, material_entry->scale_function(board));
+
+		if(trace)
+		{
+			trace->total = total;
+			trace->phase = material_entry->phase;
+			trace->scale = scale;
+		}
+
+		total.eg = total.eg * scale / kScaleNormal;
+
+		int score = taper(total, material_entry->phase);
+
+		return (side == WHITE)?score:-score;
+	}
+}
+
+void init()
+{
+	for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+	{
+		for(int square = A8; square < NUM_SQUARES; ++square)
+		{
+			Score value = kPieceValues[piece] 
+				+ Score{kMiddlegameTables[piece][square], kEndgameTables[piece][square]};
+
+			// Flipping the rank turns A8 into A1 for the black pieces.
+			int mirrored = square ^ 56;
+
+			psq[WHITE_PAWNS + piece][square] = value;
+			psq[BLACK_PAWNS + piece][mirrored] = -value;
+		}
+	}
+}
+
+int evaluate(const Board& board, PawnTable *pawn_table, MaterialTable *material_table)
+{
+	return evaluate_classical(board, pawn_table, material_table, nullptr);
 }
 
-int evaluate_pawn_structure(const Board& board, Side side)
+int evaluate_trace(const Board& board, EvalTrace *trace)
 {
-	return 0;	//TODO
+	return evaluate_classical(board, nullptr, nullptr, trace);
 }
 
 }
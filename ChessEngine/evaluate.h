@@ -2,22 +2,122 @@
 #define EVALUATE_H
 
 #include "board.h"
+#include "pawns.h"
+#include "material.h"
 
-namespace evaluation
+#include <vector>
+
+const int kDefaultEvalCacheSize = 1 << 17;
+
+// Caches the static evaluation of positions by their hash. Each
+// search thread has its own cache like the pawn table. An entry
+// packs the upper 48 bits of the hash and a 16 bit score.
+class EvalCache
 {
+public:
+    // The size is the number of entries and must be a power of two.
+    EvalCache(int size = kDefaultEvalCacheSize);
+
+    void Clear();
+
+    // Returns true and sets score if the position is in the cache.
+    bool Probe(u64 hash, int *score) const
+    {
+        u64 entry = entries_[hash & (entries_.size() - 1)];
+        if((entry ^ hash) & kKeyMask)
+            return false;
+
+        *score = (int16_t)(entry & ~kKeyMask);
+        return true;
+    }
 
-const int kQueenScore = 900;
-const int kRookScore = 500;
-const int kBishopScore = 300;
-const int kKnightScore = 300;
-const int kPawnScore = 100;
+    void Store(u64 hash, int score)
+    {
+        entries_[hash & (entries_.size() - 1)] = (hash & kKeyMask) | (u16)score;
+    }
+
+private:
+    static const u64 kKeyMask = ~0xFFFFULL;
+
+    std::vector<u64> entries_;
+};
+
+namespace evaluation
+{
 
 const int kDrawScore = 0;
 const int kMateScore = 100000;
 
-const int pawn_structure_weight = 1;
+// Material values indexed by the Piece enum.
+const Score kPieceValues[NUM_PIECES] = 
+{
+    {82, 94}, {337, 281}, {365, 297}, {477, 512}, {1025, 936}, {0, 0}
+};
+
+// Contribution of each piece to the game phase. The phase is 
+// kMaxPhase with all the pieces on the board and 0 when only 
+// the kings and pawns are left.
+const int kPhaseWeights[NUM_PIECES] = {0, 1, 1, 2, 4, 0};
+const int kMaxPhase = 24;
+
+// Mobility bonus per attacked square in the mobility area, relative 
+// to the typical number of squares. Indexed by the Piece enum.
+const Score kMobilityWeight[NUM_PIECES] = {{0, 0}, {4, 4}, {5, 5}, {2, 4}, {1, 2}, {0, 0}};
+const int kMobilityCenter[NUM_PIECES] = {0, 4, 6, 7, 13, 0};
+
+const Score kRookOnOpenFile = {45, 20};
+const Score kRookOnSemiOpenFile = {20, 7};
+
+const Score kThreatByPawn = {60, 40};
+const Score kThreatByMinor = {30, 30};
+const Score kThreatByRook = {35, 20};
+const Score kHangingPiece = {35, 20};
+
+// Piece-square tables without the material values. 
+// From white's point of view with A8 first.
+extern const int kMiddlegameTables[NUM_PIECES][NUM_SQUARES];
+extern const int kEndgameTables[NUM_PIECES][NUM_SQUARES];
+
+// Material plus piece-square value of each piece on each square 
+// from white's point of view. Filled by init.
+extern Score psq[NUM_PIECE_TYPES][NUM_SQUARES];
+
+void init();
+
+// Number of times each of the linear terms above appears in a
+// position, white's count minus black's. The tuner uses it to
+// write the evaluation as a sum of coefficients times values.
+struct EvalTrace
+{
+    int material[NUM_PIECES];
+    int psq[NUM_PIECES][NUM_SQUARES];
+    int mobility[NUM_PIECES];
+    int rook_on_open_file;
+    int rook_on_semi_open_file;
+    int threat_by_pawn;
+    int threat_by_minor;
+    int threat_by_rook;
+    int hanging_piece;
+
+    // All the terms from white's point of view 
+    // before the endgame scaling and the tapering.
+    Score total;
+    int phase;
+    int scale;
+
+    // False when the position is scored as a draw or
+    // by an endgame function instead of the terms.
+    bool linear;
+};
+
+// Returns the evaluation in centipawns from the side to 
+// move's point of view. The pawn structure and material 
+// terms are cached in the tables if they are given.
+int evaluate(const Board& board, PawnTable *pawn_table = nullptr, MaterialTable *material_table = nullptr);
 
-float evaluate(Board *board);
+// Evaluates the position with the classical evaluation
+// and fills the trace. Returns the same score as evaluate.
+int evaluate_trace(const Board& board, EvalTrace *trace);
 
 }
 
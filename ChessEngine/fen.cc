@@ -0,0 +1,325 @@
+#include "fen.h"
+#include "bitboards.h"
+#include "util.h"
+
+#include <charconv>
+
+namespace
+{
+    const char kPieceCharacters[] = "PNBRQKpnbrqk";
+
+    inline bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    // Splits off the next whitespace separated field.
+    std::string_view next_field(std::string_view *text)
+    {
+        size_t begin = 0;
+        while(begin < text->size() && is_space((*text)[begin]))
+            ++begin;
+
+        size_t end = begin;
+        while(end < text->size() && !is_space((*text)[end]))
+            ++end;
+
+        std::string_view field = text->substr(begin, end - begin);
+        text->remove_prefix(end);
+        return field;
+    }
+
+    bool parse_number(std::string_view field, unsigned *value)
+    {
+        auto result = std::from_chars(field.data(), field.data() + field.size(), *value);
+        return result.ec == std::errc() && result.ptr == field.data() + field.size();
+    }
+
+    bool parse_placement(std::string_view field, Bitboard *pieces)
+    {
+        std::fill(pieces, pieces + NUM_PIECE_TYPES, 0);
+
+        int square = A8;
+        int file = 0;
+
+        for(char c : field)
+        {
+            if(c == '/')
+            {
+                // The rank has to be complete.
+                if(file != NUM_FILES || square == NUM_SQUARES)
+                    return false;
+
+                file = 0;
+                continue;
+            }
+
+            if(c >= '1' && c <= '8')
+            {
+                file += c - '0';
+                square += c - '0';
+            }
+            else
+            {
+                const char *piece = std::char_traits<char>::find(kPieceCharacters, NUM_PIECE_TYPES, c);
+                if(piece == nullptr || file >= NUM_FILES)
+                    return false;
+
+                pieces[piece - kPieceCharacters] |= bb_from_square((Square)square);
+                ++file;
+                ++square;
+            }
+
+            if(file > NUM_FILES)
+                return false;
+        }
+
+        if(square != NUM_SQUARES || file != NUM_FILES)
+            return false;
+
+        if(PopulationCount(pieces[WHITE_KING]) != 1 || PopulationCount(pieces[BLACK_KING]) != 1)
+            return false;
+
+        Bitboard pawns = pieces[WHITE_PAWNS] | pieces[BLACK_PAWNS];
+        return !(pawns & (kBitboardRank1 | kBitboardRank8));
+    }
+
+    bool parse_castling(std::string_view field, const Bitboard *pieces, u8 *castling_rights)
+    {
+        *castling_rights = 0;
+        if(field == "-")
+            return true;
+
+        for(char c : field)
+        {
+            u8 right;
+            Square king, rook;
+            PieceType king_type, rook_type;
+
+            switch(c)
+            {
+                case 'K': right = WHITE_KINGSIDE; king = E1; rook = H1; king_type = WHITE_KING; rook_type = WHITE_ROOKS; break;
+                case 'Q': right = WHITE_QUEENSIDE; king = E1; rook = A1; king_type = WHITE_KING; rook_type = WHITE_ROOKS; break;
+                case 'k': right = BLACK_KINGSIDE; king = E8; rook = H8; king_type = BLACK_KING; rook_type = BLACK_ROOKS; break;
+                case 'q': right = BLACK_QUEENSIDE; king = E8; rook = A8; king_type = BLACK_KING; rook_type = BLACK_ROOKS; break;
+                default: return false;
+            }
+
+            if(*castling_rights & right)
+                return false;
+
+            if(!(pieces[king_type] & bb_from_square(king)) || !(pieces[rook_type] & bb_from_square(rook)))
+                return false;
+
+            *castling_rights |= right;
+        }
+
+        return !field.empty();
+    }
+
+    bool parse_en_passant(std::string_view field, Side side_to_move, Square *square)
+    {
+        *square = SQUARE_NONE;
+        if(field == "-")
+            return true;
+
+        if(field.size() != 2 || field[0] < 'a' || field[0] > 'h')
+            return false;
+
+        // The square behind a pawn that has just moved two squares.
+        char rank = (side_to_move == WHITE)?'6':'3';
+        if(field[1] != rank)
+            return false;
+
+        *square = (Square)(('8' - field[1]) * NUM_FILES + (field[0] - 'a'));
+        return true;
+    }
+
+    // Parses the first four fields shared by FEN and EPD.
+    bool parse_position(std::string_view *text, Bitboard *pieces, State *state)
+    {
+        std::string_view placement = next_field(text);
+        std::string_view side = next_field(text);
+        std::string_view castling = next_field(text);
+        std::string_view en_passant = next_field(text);
+
+        if(!parse_placement(placement, pieces))
+            return false;
+
+        if(side != "w" && side != "b")
+            return false;
+
+        *state = State();
+        state->side_to_move = (side == "w")?WHITE:BLACK;
+        state->half_moves = 0;
+        state->full_moves = 1;
+
+        if(!parse_castling(castling, pieces, &state->castling_rights))
+            return false;
+
+        // The castling code checks this instead of the rights.
+        state->king_has_moved[WHITE] = !(state->castling_rights & (WHITE_KINGSIDE | WHITE_QUEENSIDE));
+        state->king_has_moved[BLACK] = !(state->castling_rights & (BLACK_KINGSIDE | BLACK_QUEENSIDE));
+
+        return parse_en_passant(en_passant, state->side_to_move, &state->en_passant_square);
+    }
+
+    char *write_number(char *out, unsigned value)
+    {
+        return std::to_chars(out, out + 10, value).ptr;
+    }
+}
+
+namespace fen
+{
+
+bool parse(std::string_view fen, Bitboard *pieces, State *state)
+{
+    if(!parse_position(&fen, pieces, state))
+        return false;
+
+    std::string_view half_moves = next_field(&fen);
+    std::string_view full_moves = next_field(&fen);
+
+    if(!half_moves.empty() && !parse_number(half_moves, &state->half_moves))
+        return false;
+
+    if(!full_moves.empty() && !parse_number(full_moves, &state->full_moves))
+        return false;
+
+    return next_field(&fen).empty();
+}
+
+bool parse_epd(std::string_view epd, Bitboard *pieces, State *state, std::string_view *operations)
+{
+    if(!parse_position(&epd, pieces, state))
+        return false;
+
+    while(!epd.empty() && is_space(epd.front()))
+        epd.remove_prefix(1);
+
+    *operations = epd;
+
+    std::string_view operands;
+    if(find_operation(epd, "hmvc", &operands) && !parse_number(next_field(&operands), &state->half_moves))
+        return false;
+
+    if(find_operation(epd, "fmvn", &operands) && !parse_number(next_field(&operands), &state->full_moves))
+        return false;
+
+    return true;
+}
+
+bool find_operation(std::string_view operations, std::string_view opcode, std::string_view *operands)
+{
+    while(!operations.empty())
+    {
+        std::string_view current = next_field(&operations);
+        if(current.empty())
+            return false;
+
+        // The operands end at the first semicolon outside quotes.
+        size_t end = 0;
+        bool quoted = false;
+        while(end < operations.size() && (quoted || operations[end] != ';'))
+        {
+            if(operations[end] == '"')
+                quoted = !quoted;
+            ++end;
+        }
+
+        // An opcode without operands can end with its semicolon.
+        bool bare = current.back() == ';';
+        if(bare)
+            current.remove_suffix(1);
+
+        if(current == opcode)
+        {
+            *operands = bare?std::string_view():operations.substr(0, end);
+
+            while(!operands->empty() && is_space(operands->front()))
+                operands->remove_prefix(1);
+
+            return true;
+        }
+
+        if(!bare)
+            operations.remove_prefix(std::min(end + 1, operations.size()));
+    }
+
+    return false;
+}
+
+size_t write(const Board& board, char *buffer, bool epd)
+{
+    // Mailbox of the piece characters, filled from the bitboards.
+    char squares[NUM_SQUARES] = {};
+    for(int piece = WHITE_PAWNS; piece < NUM_PIECE_TYPES; ++piece)
+    {
+        Bitboard bitboard = board.pieces_[piece];
+        while(bitboard)
+            squares[PopLSB(&bitboard)] = kPieceCharacters[piece];
+    }
+
+    char *out = buffer;
+    for(int rank = 0; rank < NUM_RANKS; ++rank)
+    {
+        int empty_squares = 0;
+        for(int file = 0; file < NUM_FILES; ++file)
+        {
+            char c = squares[rank * NUM_FILES + file];
+            if(!c)
+            {
+                ++empty_squares;
+                continue;
+            }
+
+            if(empty_squares)
+                *out++ = (char)('0' + empty_squares);
+
+            empty_squares = 0;
+            *out++ = c;
+        }
+
+        if(empty_squares)
+            *out++ = (char)('0' + empty_squares);
+
+        if(rank != NUM_RANKS - 1)
+            *out++ = '/';
+    }
+
+    const State& state = board.state_;
+
+    *out++ = ' ';
+    *out++ = (state.side_to_move == WHITE)?'w':'b';
+    *out++ = ' ';
+
+    if(!state.castling_rights)
+        *out++ = '-';
+    if(state.castling_rights & WHITE_KINGSIDE) *out++ = 'K';
+    if(state.castling_rights & WHITE_QUEENSIDE) *out++ = 'Q';
+    if(state.castling_rights & BLACK_KINGSIDE) *out++ = 'k';
+    if(state.castling_rights & BLACK_QUEENSIDE) *out++ = 'q';
+
+    *out++ = ' ';
+    if(state.en_passant_square == SQUARE_NONE)
+        *out++ = '-';
+    else
+    {
+        *out++ = (char)('a' + state.en_passant_square % NUM_FILES);
+        *out++ = (char)('8' - state.en_passant_square / NUM_FILES);
+    }
+
+    if(!epd)
+    {
+        *out++ = ' ';
+        out = write_number(out, state.half_moves);
+        *out++ = ' ';
+        out = write_number(out, state.full_moves);
+    }
+
+    *out = '\0';
+    return out - buffer;
+}
+
+}
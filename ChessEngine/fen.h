@@ -0,0 +1,43 @@
+#ifndef FEN_H_
+#define FEN_H_
+
+#include "board.h"
+
+#include <string_view>
+
+// Reading and writing of FEN and EPD strings without allocating.
+// Used by the board and by the tools that process large position
+// files (analyze, tune).
+namespace fen
+{
+    // Enough for any FEN string including the terminating null.
+    const size_t kMaxFenLength = 128;
+
+    // Parses a FEN string. The input is validated strictly: eight
+    // ranks of eight squares, one king per side, no pawns on the
+    // first or last rank, castling rights that match the king and
+    // rook squares and an en passant square on the right rank. The
+    // move counters are optional and default to 0 and 1. Only
+    // whitespace may follow the fields. Returns false on an error,
+    // in which case pieces and state are unspecified.
+    bool parse(std::string_view fen, Bitboard *pieces, State *state);
+
+    // Parses an EPD line: the first four FEN fields followed by
+    // operations of the form "opcode operands;". The hmvc and fmvn
+    // operations set the move counters. operations is set to the
+    // text after the position fields.
+    bool parse_epd(std::string_view epd, Bitboard *pieces, State *state, std::string_view *operations);
+
+    // Finds an operation in the operations of an EPD line and sets
+    // operands to its operands without the terminating semicolon.
+    // Semicolons inside quoted strings are skipped.
+    bool find_operation(std::string_view operations, std::string_view opcode, std::string_view *operands);
+
+    // Writes the FEN string of the board to buffer, which has to hold
+    // kMaxFenLength characters. The string is null terminated. With
+    // epd set only the four position fields are written. Returns the
+    // length of the string.
+    size_t write(const Board& board, char *buffer, bool epd = false);
+}
+
+#endif // FEN_H_
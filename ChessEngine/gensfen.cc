@@ -0,0 +1,354 @@
+#include "gensfen.h"
+#include "engine.h"
+#include "search.h"
+#include "move_generation.h"
+#include "bitboards.h"
+#include "output.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Writes the records on its own thread so that the game
+    // threads never wait for the disk. The game threads hand
+    // over the positions of a whole game at a time.
+    class RecordWriter
+    {
+    public:
+        RecordWriter(std::FILE *file)
+            : file_(file), done_(false), written_(0)
+        {
+            thread_ = std::thread(&RecordWriter::Run, this);
+        }
+
+        ~RecordWriter()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_ = true;
+            }
+            condition_.notify_one();
+            thread_.join();
+        }
+
+        void Push(std::vector<PackedPosition>&& records)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_.insert(pending_.end(), records.begin(), records.end());
+            }
+            condition_.notify_one();
+        }
+
+        u64 Written() const {return written_.load(std::memory_order_relaxed);}
+
+    private:
+        void Run()
+        {
+            std::vector<PackedPosition> buffer;
+
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    condition_.wait(lock, [this]{return done_ || !pending_.empty();});
+
+                    if(pending_.empty() && done_)
+                        break;
+
+                    buffer.swap(pending_);
+                }
+
+                std::fwrite(buffer.data(), sizeof(PackedPosition), buffer.size(), file_);
+                written_.fetch_add(buffer.size(), std::memory_order_relaxed);
+                buffer.clear();
+            }
+
+            std::fflush(file_);
+        }
+
+        std::FILE *file_;
+
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        std::vector<PackedPosition> pending_;
+        bool done_;
+
+        std::atomic<u64> written_;
+        std::thread thread_;
+    };
+
+    void generate_legal_moves(const Board& board, std::vector<Move> *moves)
+    {
+        moves->clear();
+
+        if(board.SideToMove() == WHITE)
+            move_generation::LegalAll<WHITE>(board,moves);
+        else
+            move_generation::LegalAll<BLACK>(board,moves);
+    }
+
+    // Plays the random opening moves. Returns false
+    // if the game ended during the opening.
+    bool play_opening(Board *board, int random_moves, std::mt19937_64 *rng)
+    {
+        std::vector<Move> moves;
+
+        for(int i = 0; i < random_moves; ++i)
+        {
+            generate_legal_moves(*board, &moves);
+            if(moves.empty())
+                return false;
+
+            board->MakeMove(moves[(*rng)() % moves.size()]);
+        }
+
+        return true;
+    }
+
+    // Plays games until the total number of positions has been
+    // reached. Each game thread has its own search and board.
+    void play_games(const GenSfenParameters& parameters, int id,
+                    std::atomic<u64> *total, RecordWriter *writer)
+    {
+        Search search;
+        search.silent = true;
+        search.transposition_table.SetSize(parameters.hash_mb);
+        search.network = parameters.network;
+
+        std::random_device seed;
+        std::mt19937_64 rng(seed() ^ ((u64)id << 32));
+
+        std::vector<Move> moves;
+        std::vector<PackedPosition> records;
+        std::vector<Side> sides;
+
+        while(total->load(std::memory_order_relaxed) < parameters.count)
+        {
+            Board board;
+            board.SetPositionFromFEN(kFenStartPosition);
+
+            if(!play_opening(&board, parameters.random_moves, &rng))
+                continue;
+
+            records.clear();
+            sides.clear();
+
+            // From white's point of view.
+            int result = 0;
+
+            for(int ply = 0; ply < parameters.max_ply; ++ply)
+            {
+                generate_legal_moves(board, &moves);
+
+                Side side = board.SideToMove();
+                bool in_check = board.InCheck(side);
+
+                if(moves.empty())
+                {
+                    if(in_check)
+                        result = (side == WHITE)?-1:1;
+                    break;
+                }
+
+                search.depth = parameters.depth;
+                search.nodes = parameters.nodes;
+                search.duration = 0;
+                search.infinite = false;
+
+                StartSearch(&search, board);
+                WaitForSearchFinished(&search);
+
+                Move move = search.best_move;
+                int score = search.best_eval;
+
+                if(score >= parameters.eval_limit || score <= -parameters.eval_limit)
+                {
+                    result = ((score > 0) == (side == WHITE))?1:-1;
+                    break;
+                }
+
+                // The evaluation of positions in the middle of an
+                // exchange or in check doesn't match the score.
+                bool quiet = !in_check && !move.capture && move.type != PROMOTION;
+
+                PackedPosition packed;
+                if(quiet && gensfen::pack_position(board, score, parameters.random_moves + ply, 0, &packed))
+                {
+                    records.push_back(packed);
+                    sides.push_back(side);
+                }
+
+                board.MakeMove(move);
+
+                // The board keeps the game history, so with no
+                // search plies this is the threefold repetition.
+                if(board.IsDraw(0))
+                {
+                    result = 0;
+                    break;
+                }
+            }
+
+            for(size_t i = 0; i < records.size(); ++i)
+                records[i].result = (int8_t)((sides[i] == WHITE)?result:-result);
+
+            // Another thread may have finished its game first, so the
+            // records are trimmed to the positions that are still needed.
+            u64 written = total->load(std::memory_order_relaxed);
+            u64 taken;
+            do
+            {
+                if(written >= parameters.count)
+                    return;
+                taken = std::min<u64>(records.size(), parameters.count - written);
+            }
+            while(!total->compare_exchange_weak(written, written + taken, std::memory_order_relaxed));
+
+            records.resize(taken);
+            writer->Push(std::move(records));
+            records = std::vector<PackedPosition>();
+        }
+    }
+}
+
+namespace gensfen
+{
+
+bool pack_position(const Board& board, int score, int ply, int result, PackedPosition *packed)
+{
+    Bitboard occupied = board.GetOccupied();
+    if(PopulationCount(occupied) > 32)
+        return false;
+
+    *packed = PackedPosition();
+    packed->occupied = occupied;
+
+    int index = 0;
+    while(occupied)
+    {
+        Square square = PopLSB(&occupied);
+        u8 piece = (u8)board.GetPieceOnSquare(square);
+
+        packed->pieces[index / 2] |= (index % 2)?(piece << 4):piece;
+        ++index;
+    }
+
+    const State& state = board.state_;
+    packed->flags = (u8)(state.side_to_move | (state.castling_rights << 1));
+    packed->en_passant = (state.en_passant_square != SQUARE_NONE)?(u8)(state.en_passant_square % NUM_FILES + 1):0;
+    packed->half_moves = (u8)std::min(state.half_moves, 255u);
+    packed->result = (int8_t)result;
+    packed->score = (int16_t)std::max(-32000, std::min(32000, score));
+    packed->ply = (u16)ply;
+
+    return true;
+}
+
+void unpack_position(const PackedPosition& packed, Board *board)
+{
+    Bitboard pieces[NUM_PIECE_TYPES] = {};
+
+    Bitboard occupied = packed.occupied;
+    int index = 0;
+    while(occupied)
+    {
+        Square square = PopLSB(&occupied);
+        int piece = (packed.pieces[index / 2] >> ((index % 2) * 4)) & 0xF;
+
+        pieces[piece] |= bb_from_square(square);
+        ++index;
+    }
+
+    State state;
+    state.side_to_move = (Side)(packed.flags & 1);
+    state.castling_rights = (packed.flags >> 1) & 0xF;
+    state.half_moves = packed.half_moves;
+    state.full_moves = packed.ply / 2 + 1;
+    state.en_passant_square = SQUARE_NONE;
+
+    // The en passant square is behind the pawn that just moved.
+    if(packed.en_passant)
+    {
+        int rank_offset = (state.side_to_move == WHITE)?2 * NUM_FILES:5 * NUM_FILES;
+        state.en_passant_square = (Square)(rank_offset + packed.en_passant - 1);
+    }
+
+    state.king_has_moved[WHITE] = !(state.castling_rights & (WHITE_KINGSIDE | WHITE_QUEENSIDE));
+    state.king_has_moved[BLACK] = !(state.castling_rights & (BLACK_KINGSIDE | BLACK_QUEENSIDE));
+
+    board->history_.clear();
+    board->Reset(pieces, state);
+    board->UpdateZobristHash();
+}
+
+void generate(const GenSfenParameters& parameters)
+{
+    std::FILE *file = std::fopen(parameters.output.c_str(), "ab");
+    if(file == nullptr)
+    {
+        output::send("info string Couldn't open " + parameters.output);
+        return;
+    }
+
+    int threads = parameters.threads;
+    if(threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::atomic<u64> total(0);
+    auto start = std::chrono::steady_clock::now();
+
+    {
+        RecordWriter writer(file);
+
+        std::vector<std::thread> game_threads;
+        for(int i = 0; i < threads; ++i)
+            game_threads.emplace_back(play_games, std::cref(parameters), i, &total, &writer);
+
+        // Report the progress until the game threads are done.
+        std::atomic<bool> done(false);
+        std::thread reporter([&]{
+            while(!done.load())
+            {
+                for(int i = 0; i < 50 && !done.load(); ++i)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                u64 positions = total.load();
+
+                std::ostringstream info;
+                info << "info string gensfen positions " << positions << " of " << parameters.count
+                     << " positions/s " << (u64)(positions / std::max(seconds, 0.001));
+                output::send(info.str());
+            }
+        });
+
+        for(std::thread& thread : game_threads)
+            thread.join();
+
+        done = true;
+        reporter.join();
+
+        // The writer flushes the remaining records when it's destroyed.
+    }
+
+    std::fclose(file);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ostringstream info;
+    info << "info string gensfen done: " << total.load() << " positions in "
+         << (u64)seconds << " s to " << parameters.output;
+    output::send(info.str());
+}
+
+}
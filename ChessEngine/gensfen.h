@@ -0,0 +1,83 @@
+#ifndef GENSFEN_H_
+#define GENSFEN_H_
+
+#include "board.h"
+
+#include <memory>
+#include <string>
+
+// A scored position in 32 bytes. The pieces are stored as
+// 4 bit piece types in the order of the occupied squares from
+// the least significant bit of the occupied bitboard.
+struct PackedPosition
+{
+    u64 occupied;
+    u8 pieces[16];
+
+    // Bit 0: side to move, bits 1-4: castling rights.
+    u8 flags;
+
+    // File of the en passant square plus one, 0 for none.
+    u8 en_passant;
+    u8 half_moves;
+
+    // Game result from the side to move's point
+    // of view: 1 for a win, 0 for a draw, -1 for a loss.
+    int8_t result;
+
+    // Search score in centipawns from the side to move's point of view.
+    int16_t score;
+    u16 ply;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
+// Parameters of the gensfen command.
+struct GenSfenParameters
+{
+    // Search limits of each move. 0 for no limit.
+    int depth = 8;
+    u64 nodes = 0;
+
+    // Number of positions to write.
+    u64 count = 1000000;
+
+    // 0 to use all the cores.
+    int threads = 0;
+
+    // Random moves played from the start position
+    // before the positions are recorded.
+    int random_moves = 8;
+
+    // Games are adjudicated as a draw after max_ply moves and
+    // as a win when the score is at least eval_limit.
+    int max_ply = 400;
+    int eval_limit = 3000;
+
+    // Transposition table size of each game thread.
+    int hash_mb = 16;
+
+    std::string output = "sfens.bin";
+
+    // Network of the NNUE evaluation, nullptr
+    // for the classical evaluation.
+    std::shared_ptr<const nnue::Network> network;
+};
+
+namespace gensfen
+{
+    // Returns false if the position has more than 32 pieces.
+    bool pack_position(const Board& board, int score, int ply, int result, PackedPosition *packed);
+
+    // Sets the board to the packed position.
+    void unpack_position(const PackedPosition& packed, Board *board);
+
+    // Plays self-play games on parameters.threads threads and writes
+    // the quiet positions of the games with their scores and results
+    // to the output file. Blocks until exactly parameters.count 
+    // positions have been written. The positions of the games that
+    // finish last are cut off at the count.
+    void generate(const GenSfenParameters& parameters);
+}
+
+#endif // GENSFEN_H_
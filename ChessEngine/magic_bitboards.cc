@@ -313,7 +313,7 @@ Bitboard queen_moves(Bitboard occupied, Square square)
 
 void init()
 {
-	std::cout << "Initializing magic bitboards...\n";
+	std::cerr << "Initializing magic bitboards...\n";
 	init_rook_occupancy_variations();
 	init_bishop_occupancy_variations();
 	generate_rook_magics();
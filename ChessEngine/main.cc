@@ -1,6 +1,7 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstdio>
 
 #include "attacks.h"
 #include "bitboards.h"
@@ -10,14 +11,40 @@
 #include "util.h"
 #include "uci.h"
 #include "tests.h"
+#include "evaluate.h"
+#include "engine.h"
+#include "analyze.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
 
 int main(int argc, char **argv)
 {
-    init_bitboards();
-    Board::InitZobristHashing();
-    move_generation::Init();
+    Engine::InitTables();
+
+    // ChessEngine analyze file.epd [options]
+    if(argc > 1 && std::string(argv[1]) == "analyze")
+    {
+        AnalyzeParameters parameters;
+        if(!analyze::parse_arguments(argc - 2, argv + 2, &parameters))
+        {
+            std::cerr << "Usage: ChessEngine analyze file.epd [--depth d] [--nodes n] [--movetime ms] "
+                         "[--threads t] [--hash mb] [--output file]\n";
+            return 1;
+        }
+
+        return analyze::run(parameters)?0:1;
+    }
+
 	tests::init_perft();
-    uci::loop();
+
+    // Prompts are only printed when a person is typing the commands.
+    uci::loop(isatty(fileno(stdin)));
        
     return 0;
 };
@@ -0,0 +1,286 @@
+#include "match.h"
+#include "engine.h"
+#include "move_generation.h"
+#include "output.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Results of the test engine.
+    enum GameResult
+    {
+        LOSS,
+        DRAW,
+        WIN
+    };
+
+    // Win, draw and loss counts of the test engine
+    // shared by the game threads.
+    struct MatchState
+    {
+        std::mutex mutex;
+        int results[3] = {0, 0, 0};
+
+        // Index of the next game to play.
+        std::atomic<int> next_game{0};
+
+        // Set when the SPRT has reached a decision.
+        std::atomic<bool> finished{false};
+    };
+
+    struct Statistics
+    {
+        int games;
+        double elo;
+        double error;
+        double llr;
+    };
+
+    inline double expected_score(double elo)
+    {
+        return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+    }
+
+    inline double elo_from_score(double score)
+    {
+        score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+        return -400.0 * std::log10(1.0 / score - 1.0);
+    }
+
+    // Elo estimate with a 95% confidence interval and the log-likelihood
+    // ratio of elo1 against elo0 with the normal approximation of the
+    // trinomial score distribution.
+    Statistics statistics(const int results[3], const MatchParameters& parameters)
+    {
+        Statistics stats = {0, 0.0, 0.0, 0.0};
+        stats.games = results[WIN] + results[DRAW] + results[LOSS];
+        if(stats.games == 0)
+            return stats;
+
+        double n = stats.games;
+        double w = results[WIN] / n, d = results[DRAW] / n, l = results[LOSS] / n;
+
+        double score = w + d / 2;
+        double variance = w * (1 - score) * (1 - score)
+                        + d * (0.5 - score) * (0.5 - score)
+                        + l * score * score;
+
+        double deviation = std::sqrt(variance / n);
+        stats.elo = elo_from_score(score);
+        stats.error = (elo_from_score(score + 1.96 * deviation) - elo_from_score(score - 1.96 * deviation)) / 2;
+
+        if(variance > 0)
+        {
+            double s0 = expected_score(parameters.elo0);
+            double s1 = expected_score(parameters.elo1);
+            stats.llr = n * (s1 - s0) * (2 * score - s0 - s1) / (2 * variance);
+        }
+
+        return stats;
+    }
+
+    void report(const int results[3], const MatchParameters& parameters, const char *status)
+    {
+        Statistics stats = statistics(results, parameters);
+
+        double lower = std::log(parameters.beta / (1 - parameters.alpha));
+        double upper = std::log((1 - parameters.beta) / parameters.alpha);
+
+        std::ostringstream info;
+        info << std::fixed << std::setprecision(1)
+             << "info string match " << status << " games " << stats.games
+             << " W " << results[WIN] << " D " << results[DRAW] << " L " << results[LOSS]
+             << " elo " << stats.elo << " +- " << stats.error
+             << std::setprecision(2) << " llr " << stats.llr
+             << " (" << lower << ", " << upper << ")";
+        output::send(info.str());
+    }
+
+    void load_openings(const std::string& path, std::vector<std::string> *openings)
+    {
+        std::ifstream file(path);
+        std::string line;
+
+        while(std::getline(file, line))
+        {
+            std::istringstream iss(line);
+            std::string fields[4];
+            if(iss >> fields[0] >> fields[1] >> fields[2] >> fields[3])
+                openings->push_back(fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " 0 1");
+        }
+    }
+
+    // Plays a game from the opening and returns the
+    // result from the point of view of engines[WHITE].
+    GameResult play_game(Engine *engines[NUM_SIDES], const std::string& opening, const MatchParameters& parameters)
+    {
+        Board board;
+        board.SetPositionFromFEN(opening);
+
+        for(int side = WHITE; side < NUM_SIDES; ++side)
+            engines[side]->NewGame();
+
+        int clock[NUM_SIDES] = {parameters.base_time, parameters.base_time};
+
+        std::vector<Move> moves;
+
+        for(int ply = 0; ply < parameters.max_ply; ++ply)
+        {
+            Side side = board.SideToMove();
+
+            moves.clear();
+            if(side == WHITE)
+                move_generation::LegalAll<WHITE>(board, &moves);
+            else
+                move_generation::LegalAll<BLACK>(board, &moves);
+
+            if(moves.empty())
+            {
+                if(!board.InCheck(side))
+                    return DRAW;
+
+                return (side == WHITE)?LOSS:WIN;
+            }
+
+            Search *search = &engines[side]->search;
+            search->depth = 0;
+            search->infinite = false;
+
+            if(parameters.nodes > 0)
+            {
+                search->nodes = parameters.nodes;
+                search->duration = 0;
+            }
+            else
+            {
+                search->nodes = 0;
+                search->duration = AllocateTime(search, clock[side], parameters.increment, 0);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            engines[side]->board = board;
+            engines[side]->Go();
+            engines[side]->Wait();
+
+            if(parameters.nodes == 0)
+            {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                clock[side] -= (int)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+
+                if(clock[side] < 0)
+                    return (side == WHITE)?LOSS:WIN;
+
+                clock[side] += parameters.increment;
+            }
+
+            board.MakeMove(search->best_move);
+
+            // The board keeps the game history, so with no
+            // search plies this is the threefold repetition.
+            if(board.IsDraw(0))
+                return DRAW;
+        }
+
+        return DRAW;
+    }
+
+    // Plays games until the maximum number of games has been played
+    // or the SPRT has stopped the match. Games 2n and 2n + 1 use the
+    // same opening with the colors reversed.
+    void play_games(const MatchParameters& parameters, const std::vector<std::string>& openings, MatchState *state)
+    {
+        Engine base, test;
+        test.search.params = parameters.test_params;
+
+        for(Engine *engine : {&base, &test})
+        {
+            std::string error;
+            engine->SetOption("Hash", std::to_string(parameters.hash_mb), &error);
+            engine->search.silent = true;
+            engine->search.move_overhead = 0;
+            engine->search.network = parameters.network;
+        }
+
+        double lower = std::log(parameters.beta / (1 - parameters.alpha));
+        double upper = std::log((1 - parameters.beta) / parameters.alpha);
+
+        for(;;)
+        {
+            int game = state->next_game.fetch_add(1);
+            if(game >= parameters.games || state->finished)
+                break;
+
+            const std::string& opening = openings[(game / 2) % openings.size()];
+            bool test_is_white = (game % 2) == 1;
+
+            Engine *engines[NUM_SIDES];
+            engines[WHITE] = test_is_white?&test:&base;
+            engines[BLACK] = test_is_white?&base:&test;
+
+            GameResult result = play_game(engines, opening, parameters);
+            if(!test_is_white)
+                result = (GameResult)(WIN - result);
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            ++state->results[result];
+
+            Statistics stats = statistics(state->results, parameters);
+            if(stats.llr <= lower || stats.llr >= upper)
+            {
+                if(!state->finished.exchange(true))
+                    report(state->results, parameters, (stats.llr >= upper)?"H1 accepted":"H0 accepted");
+            }
+            else if(stats.games % 20 == 0)
+            {
+                report(state->results, parameters, "running");
+            }
+        }
+    }
+}
+
+namespace match
+{
+
+void run(const MatchParameters& parameters)
+{
+    std::vector<std::string> openings;
+    if(!parameters.openings.empty())
+        load_openings(parameters.openings, &openings);
+
+    if(openings.empty())
+    {
+        if(!parameters.openings.empty())
+            output::send("info string No openings in " + parameters.openings + ", using the start position");
+
+        openings.push_back(kFenStartPosition);
+    }
+
+    int threads = parameters.threads;
+    if(threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    MatchState state;
+
+    std::vector<std::thread> game_threads;
+    for(int i = 0; i < threads; ++i)
+        game_threads.emplace_back(play_games, std::cref(parameters), std::cref(openings), &state);
+
+    for(std::thread& thread : game_threads)
+        thread.join();
+
+    if(!state.finished)
+        report(state.results, parameters, "finished");
+}
+
+}
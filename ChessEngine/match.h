@@ -0,0 +1,59 @@
+#ifndef MATCH_H_
+#define MATCH_H_
+
+#include "search.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Parameters of the match command. The match is played between
+// two configurations of the engine in the same process: the base
+// engine and a test engine with changed search parameters.
+struct MatchParameters
+{
+    // EPD file with an opening position on each line. Each opening
+    // is played twice with the colors reversed. The start position
+    // is used if no file is given.
+    std::string openings;
+
+    // Maximum number of games. The match stops earlier
+    // when the SPRT reaches a decision.
+    int games = 1000;
+
+    // 0 to use all the cores. Each core plays its own games.
+    int threads = 0;
+
+    // Time control of both sides in milliseconds, base + increment.
+    // A node limit per move replaces the clock if it's set.
+    int base_time = 1000;
+    int increment = 10;
+    u64 nodes = 0;
+
+    int hash_mb = 16;
+
+    // Games are adjudicated as a draw after max_ply moves.
+    int max_ply = 400;
+
+    // SPRT hypotheses in Elo and the error probabilities.
+    double elo0 = 0.0;
+    double elo1 = 5.0;
+    double alpha = 0.05;
+    double beta = 0.05;
+
+    // Search parameters of the test engine.
+    SearchParameters test_params;
+
+    // Network of the NNUE evaluation of both engines,
+    // nullptr for the classical evaluation.
+    std::shared_ptr<const nnue::Network> network;
+};
+
+namespace match
+{
+    // Plays the match and reports the Elo difference of the test
+    // engine and the state of the SPRT. Blocks until the match is over.
+    void run(const MatchParameters& parameters);
+}
+
+#endif // MATCH_H_
@@ -0,0 +1,286 @@
+#include "material.h"
+#include "evaluate.h"
+#include "bitboards.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    const Score kBishopPair = {30, 50};
+
+    // Adjustments of the knight and rook values 
+    // for each own pawn more or less than five.
+    const Score kKnightPawnAdjustment = {4, 4};
+    const Score kRookPawnAdjustment = {-8, -8};
+
+    // Score of a won endgame before the bonuses 
+    // for driving the losing king to the corner.
+    const int kKnownWin = 2000;
+
+    inline int piece_count(const Board& board, Side side, Piece piece)
+    {
+        return board.PieceCount((PieceType)(side * NUM_PIECES + piece));
+    }
+
+    inline Square piece_square(const Board& board, Side side, Piece piece)
+    {
+        return square_from_bitboard(board.pieces_[side * NUM_PIECES + piece]);
+    }
+
+    inline int non_pawn_material(const Board& board, Side side)
+    {
+        int material = 0;
+        for(int piece = KNIGHTS; piece <= QUEENS; ++piece)
+            material += piece_count(board, side, (Piece)piece) * evaluation::kPieceValues[piece].mg;
+        return material;
+    }
+
+    inline int square_rank(Square square) {return square / NUM_FILES;}
+    inline int square_file(Square square) {return square % NUM_FILES;}
+
+    inline int distance(Square a, Square b)
+    {
+        return std::max(std::abs(square_rank(a) - square_rank(b)), 
+                        std::abs(square_file(a) - square_file(b)));
+    }
+
+    // 0 for light squares and 1 for dark squares. A8 is light.
+    inline int square_color(Square square)
+    {
+        return (square_rank(square) + square_file(square)) & 1;
+    }
+
+    // Rank from the side's point of view, 0 for its first rank.
+    inline int relative_rank(Side side, Square square)
+    {
+        int rank = NUM_RANKS - 1 - square_rank(square);
+        return (side == WHITE)?rank:NUM_RANKS - 1 - rank;
+    }
+
+    inline Square forward_square(Side side, Square square)
+    {
+        return (Square)(square + ((side == WHITE)?SQUARE_DIRECTION_UP:SQUARE_DIRECTION_DOWN));
+    }
+
+    // King, bishop and knight against a king. The losing king 
+    // has to be driven to a corner of the bishop's color.
+    int evaluate_kbnk(const Board& board, Side strong_side)
+    {
+        Side weak_side = get_opposing_side(strong_side);
+        Square strong_king = piece_square(board, strong_side, KINGS);
+        Square weak_king = piece_square(board, weak_side, KINGS);
+        Square bishop = piece_square(board, strong_side, BISHOPS);
+
+        Square corners[2];
+        if(square_color(bishop) == square_color(A8))
+        {
+            corners[0] = A8;
+            corners[1] = H1;
+        }
+        else
+        {
+            corners[0] = A1;
+            corners[1] = H8;
+        }
+
+        int corner_distance = std::min(distance(weak_king, corners[0]), distance(weak_king, corners[1]));
+
+        return kKnownWin 
+            + 50 * (7 - corner_distance)
+            + 10 * (7 - distance(strong_king, weak_king));
+    }
+
+    // King and rook against king and pawn. The rook 
+    // wins unless the pawn is far advanced and supported.
+    int evaluate_krkp(const Board& board, Side strong_side)
+    {
+        Side weak_side = get_opposing_side(strong_side);
+        Square strong_king = piece_square(board, strong_side, KINGS);
+        Square weak_king = piece_square(board, weak_side, KINGS);
+        Square rook = piece_square(board, strong_side, ROOKS);
+        Square pawn = piece_square(board, weak_side, PAWNS);
+
+        Square queening = (Square)((weak_side == WHITE)?square_file(pawn):square_file(pawn) + (NUM_RANKS - 1) * NUM_FILES);
+        Square push = forward_square(weak_side, pawn);
+
+        int rook_value = evaluation::kPieceValues[ROOKS].eg;
+        bool weak_to_move = board.SideToMove() == weak_side;
+        bool strong_to_move = !weak_to_move;
+
+        // The strong king is in front of the pawn.
+        if(square_file(strong_king) == square_file(pawn) 
+            && relative_rank(weak_side, strong_king) > relative_rank(weak_side, pawn))
+            return rook_value - distance(strong_king, pawn);
+
+        // The weak king is too far to support the pawn.
+        if(distance(weak_king, pawn) >= 3 + weak_to_move && distance(weak_king, rook) >= 3)
+            return rook_value - distance(strong_king, pawn);
+
+        // The pawn is far advanced and supported by its king.
+        if(relative_rank(weak_side, weak_king) >= 5 
+            && relative_rank(weak_side, pawn) >= 5 
+            && distance(weak_king, pawn) == 1
+            && distance(strong_king, pawn) > 2 + strong_to_move)
+            return 80 - 8 * distance(strong_king, pawn);
+
+        return 200 - 8 * (distance(strong_king, push) - distance(weak_king, push) - distance(pawn, queening));
+    }
+
+    // Endings with bishops of opposite colors and 
+    // no other pieces are drawish even with extra pawns.
+    int scale_opposite_bishops(const Board& board)
+    {
+        Square white_bishop = piece_square(board, WHITE, BISHOPS);
+        Square black_bishop = piece_square(board, BLACK, BISHOPS);
+
+        if(square_color(white_bishop) == square_color(black_bishop))
+            return kScaleNormal;
+
+        int pawn_difference = std::abs(piece_count(board, WHITE, PAWNS) - piece_count(board, BLACK, PAWNS));
+        return std::min(kScaleNormal, 16 + 8 * pawn_difference);
+    }
+
+    bool only_king(const Board& board, Side side)
+    {
+        for(int piece = PAWNS; piece <= QUEENS; ++piece)
+            if(piece_count(board, side, (Piece)piece)) return false;
+        return true;
+    }
+
+    // True if the side has only the given pieces besides the king.
+    bool has_only(const Board& board, Side side, int knights, int bishops, int rooks, int queens, int pawns)
+    {
+        return piece_count(board, side, KNIGHTS) == knights
+            && piece_count(board, side, BISHOPS) == bishops
+            && piece_count(board, side, ROOKS) == rooks
+            && piece_count(board, side, QUEENS) == queens
+            && piece_count(board, side, PAWNS) == pawns;
+    }
+
+    Score imbalance(const Board& board, Side side)
+    {
+        Score score = {0, 0};
+
+        if(piece_count(board, side, BISHOPS) >= 2)
+            score += kBishopPair;
+
+        int pawns = piece_count(board, side, PAWNS) - 5;
+        score += kKnightPawnAdjustment * (pawns * piece_count(board, side, KNIGHTS));
+        score += kRookPawnAdjustment * (pawns * piece_count(board, side, ROOKS));
+
+        return score;
+    }
+
+    void find_endgame(const Board& board, MaterialEntry *entry)
+    {
+        for(int side = WHITE; side < NUM_SIDES; ++side)
+        {
+            Side strong = (Side)side;
+            Side weak = get_opposing_side(strong);
+
+            if(has_only(board, strong, 1, 1, 0, 0, 0) && only_king(board, weak))
+                entry->endgame = evaluate_kbnk;
+            else if(has_only(board, strong, 0, 0, 1, 0, 0) && has_only(board, weak, 0, 0, 0, 0, 1))
+                entry->endgame = evaluate_krkp;
+
+            if(entry->endgame)
+            {
+                entry->strong_side = strong;
+                return;
+            }
+        }
+    }
+}
+
+MaterialTable::MaterialTable(int size)
+    : entries_(size)
+{
+    Clear();
+}
+
+void MaterialTable::Clear()
+{
+    // Key 0 is the position without any pieces so the empty 
+    // entries have to be valid entries of that position.
+    MaterialEntry empty;
+    material::evaluate_material(Board(), &empty);
+
+    std::fill(entries_.begin(), entries_.end(), empty);
+}
+
+MaterialEntry* MaterialTable::Probe(const Board& board)
+{
+    u64 key = board.MaterialKey();
+    MaterialEntry *entry = &entries_[key & (entries_.size() - 1)];
+
+    if(entry->key == key)
+        return entry;
+
+    material::evaluate_material(board, entry);
+    return entry;
+}
+
+namespace material
+{
+
+void evaluate_material(const Board& board, MaterialEntry *entry)
+{
+    entry->key = board.MaterialKey();
+    entry->draw = false;
+    entry->endgame = nullptr;
+    entry->strong_side = WHITE;
+    entry->scale_function = nullptr;
+
+    entry->phase = 0;
+    for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+    {
+        int count = piece_count(board, WHITE, (Piece)piece) + piece_count(board, BLACK, (Piece)piece);
+        entry->phase += count * evaluation::kPhaseWeights[piece];
+    }
+    entry->phase = std::min(entry->phase, evaluation::kMaxPhase);
+
+    entry->imbalance = imbalance(board, WHITE) - imbalance(board, BLACK);
+
+    int npm[NUM_SIDES] = {non_pawn_material(board, WHITE), non_pawn_material(board, BLACK)};
+    int pawns[NUM_SIDES] = {piece_count(board, WHITE, PAWNS), piece_count(board, BLACK, PAWNS)};
+
+    int bishop_value = evaluation::kPieceValues[BISHOPS].mg;
+    int rook_value = evaluation::kPieceValues[ROOKS].mg;
+
+    // Without pawns a single minor piece can't mate 
+    // and neither can two knights against a bare king.
+    bool two_knights = (has_only(board, WHITE, 2, 0, 0, 0, 0) && only_king(board, BLACK))
+                    || (has_only(board, BLACK, 2, 0, 0, 0, 0) && only_king(board, WHITE));
+
+    if(!pawns[WHITE] && !pawns[BLACK] 
+        && ((npm[WHITE] <= bishop_value && npm[BLACK] <= bishop_value) || two_knights))
+    {
+        entry->draw = true;
+        return;
+    }
+
+    find_endgame(board, entry);
+
+    // A side without pawns needs more than 
+    // a minor piece of advantage to win.
+    for(int side = WHITE; side < NUM_SIDES; ++side)
+    {
+        Side weak = get_opposing_side((Side)side);
+        entry->scale[side] = kScaleNormal;
+
+        if(!pawns[side] && npm[side] - npm[weak] <= bishop_value)
+        {
+            if(npm[side] < rook_value)
+                entry->scale[side] = kScaleDraw;
+            else
+                entry->scale[side] = (npm[weak] <= bishop_value)?4:14;
+        }
+    }
+
+    if(has_only(board, WHITE, 0, 1, 0, 0, pawns[WHITE]) && has_only(board, BLACK, 0, 1, 0, 0, pawns[BLACK]))
+        entry->scale_function = scale_opposite_bishops;
+}
+
+}
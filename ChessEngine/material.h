@@ -0,0 +1,72 @@
+#ifndef MATERIAL_H_
+#define MATERIAL_H_
+
+#include "board.h"
+
+#include <vector>
+
+// Scale factors of the endgame score. kScaleNormal 
+// keeps the score and kScaleDraw turns it into a draw.
+const int kScaleNormal = 64;
+const int kScaleDraw = 0;
+
+// Evaluates a known endgame. Returns the score 
+// from the strong side's point of view.
+typedef int (*EndgameFunction)(const Board& board, Side strong_side);
+
+// Returns the scale factor of the endgame score for 
+// positions where the material alone isn't enough.
+typedef int (*ScaleFunction)(const Board& board);
+
+// Evaluation terms that depend only on the material.
+struct MaterialEntry
+{
+    u64 key;
+
+    // See evaluation::kMaxPhase.
+    int phase;
+
+    // Bishop pair and piece values adjusted 
+    // by the number of pawns from white's point of view.
+    Score imbalance;
+
+    // Set when neither side can mate.
+    bool draw;
+
+    // Replaces the evaluation if set.
+    EndgameFunction endgame;
+    Side strong_side;
+
+    // Scale factor of the endgame score when the side is 
+    // ahead. The scale function can lower it further.
+    int scale[NUM_SIDES];
+    ScaleFunction scale_function;
+};
+
+const int kDefaultMaterialTableSize = 8192;
+
+// Owned by a search thread like the pawn table. The 
+// material changes only on captures and promotions.
+class MaterialTable
+{
+public:
+    // The size is the number of entries and must be a power of two.
+    MaterialTable(int size = kDefaultMaterialTableSize);
+
+    void Clear();
+
+    // Returns the entry of the material of the board. The 
+    // entry is calculated if it's not in the table.
+    MaterialEntry* Probe(const Board& board);
+
+private:
+    std::vector<MaterialEntry> entries_;
+};
+
+namespace material
+{
+    // Calculates the material terms of the board into the entry.
+    void evaluate_material(const Board& board, MaterialEntry *entry);
+}
+
+#endif // MATERIAL_H_
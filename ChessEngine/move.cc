@@ -6,101 +6,55 @@
 
 #include <string>
 #include <iostream>
+#include <algorithm>
+
+namespace
+{
+    // Parses a square such as "e4" from two characters.
+    Square parse_square(char file, char rank)
+    {
+        if(file < 'a' || file > 'h' || rank < '1' || rank > '8')
+            return SQUARE_NONE;
+
+        return (Square)(('8' - rank) * NUM_FILES + (file - 'a'));
+    }
+}
 
 Move move_from_uci(const Board& board, const std::string& move_str)
 {
     Side side = board.state_.side_to_move;
 
     // If no move can be parsed, return these defaults.
-    Move new_move = {SQUARE_NONE,
-                     SQUARE_NONE,
-                     PIECE_TYPE_NONE,
-                     MOVE_TYPE_NONE,
-                     PIECE_TYPE_NONE,
-                     PIECE_TYPE_NONE,
-                     false}; 
-
-    if(move_str.size() < 4) return new_move;
+    Move new_move = NULL_MOVE;
 
-    Square from = square_from_algebraic(std::string() + move_str[0] + move_str[1]);
-    Square to = square_from_algebraic(std::string() + move_str[2] + move_str[3]);
+    if(move_str.size() != 4 && move_str.size() != 5) return new_move;
 
-	PieceType piece = board.GetPieceOnSquare(from);
+    Square from = parse_square(move_str[0], move_str[1]);
+    Square to = parse_square(move_str[2], move_str[3]);
 
-    Board tmp_board = board; 
+    if(from == SQUARE_NONE || to == SQUARE_NONE)
+        return new_move;
 
-	// Check if king moves into a castling move.
-	if (piece == WHITE_KING || piece == BLACK_KING)
-	{
-		if (to == G1 && from == E1 && board.CanCastle(WHITE, WHITE_KINGSIDE))
-		{
-			new_move.type = CASTLE_KINGSIDE;
-            new_move.from = from;
-            new_move.to = to;
-			new_move.piece = WHITE_KING;
-			return new_move;
-		}
-		else if (to == C1 && from == E1 && board.CanCastle(WHITE, WHITE_QUEENSIDE))
-		{
-			new_move.type = CASTLE_QUEENSIDE;
-            new_move.from = from;
-            new_move.to = to;
-			new_move.piece = WHITE_KING;
-			return new_move;
-		}
-		else if (to == G8 && from == E8 && board.CanCastle(BLACK, BLACK_KINGSIDE))
-		{
-			new_move.type = CASTLE_KINGSIDE;
-            new_move.from = from;
-            new_move.to = to;
-			new_move.piece = BLACK_KING;
-			return new_move;
-		}
-		else if (to == C8 && from == E8 && board.CanCastle(BLACK, BLACK_QUEENSIDE))
-		{
-			new_move.type = CASTLE_QUEENSIDE;
-            new_move.from = from;
-            new_move.to = to;
-			new_move.piece = BLACK_KING;
-			return new_move;
-		}
-	}
-
-    // Find out the move by matching the source and destination squares
-    // to a generated move.
-    std::vector<Move> legal_moves;
-
-    if(side == WHITE)
-        move_generation::LegalAll<WHITE>(board,&legal_moves);
-    else
-        move_generation::LegalAll<BLACK>(board,&legal_moves);
-
-    // Check that the move is a legal move.
-    for(const Move& m : legal_moves)
-    {
-        if(m.from == from && m.to == to)
-        {
-            new_move = m;
-            break;
-        }
-    }
-
-    // Promotion move.
     PieceType promotion = PIECE_TYPE_NONE;
 	if (move_str.length() == 5)
 	{
         switch(move_str[4])
         {
-            case 'k': promotion = piece_type_from_piece(KNIGHTS,side); break;
+            case 'n': promotion = piece_type_from_piece(KNIGHTS,side); break;
             case 'b': promotion = piece_type_from_piece(BISHOPS,side); break;
             case 'r': promotion = piece_type_from_piece(ROOKS,side); break;
             case 'q': promotion = piece_type_from_piece(QUEENS,side); break;
-            default: break;
+            default: return new_move;
         }
 	}
-    new_move.promotion = promotion;
 
-    return new_move;
+    // Instead of generating every legal move and searching 
+    // the list, the move is checked against the board.
+    Move move = board.MoveFromSquares(from, to, promotion);
+    if(!board.IsPseudoLegal(move))
+        return new_move;
+
+    return move;
 }
 
 void print_move(const Move& m)
@@ -140,6 +94,20 @@ std::string move_to_algebraic(const Move &m)
 	return output;
 }
 
+std::string move_to_uci(const Move &m)
+{
+	if(m.from == SQUARE_NONE || m.to == SQUARE_NONE)
+		return "0000";
+
+	std::string output = algebraic_from_square(m.from) + algebraic_from_square(m.to);
+	std::transform(output.begin(), output.end(), output.begin(), ::tolower);
+
+	if(m.promotion != PIECE_TYPE_NONE)
+		output += "nbrq"[(m.promotion % NUM_PIECES) - KNIGHTS];
+
+	return output;
+}
+
 std::vector<std::string> split_string(const std::string & input_string)
 {
 	return std::vector<std::string>();
@@ -31,7 +31,34 @@ struct Move
     bool        capture;
 };
 
-// Creates a move structure from a UCI move string token.
+// Compact 16 bit representation of a move used in the
+// search tables. Only the squares and the promotion are 
+// stored, which is enough to find the move in a generated
+// move list.
+//
+// Bits 0-5: from square, bits 6-11: to square,
+// bits 12-15: promotion piece type + 1 (0 for no promotion).
+using PackedMove = u16;
+
+const PackedMove kPackedMoveNone = 0;
+
+inline PackedMove pack_move(const Move& m)
+{
+    if(m.from == SQUARE_NONE) return kPackedMoveNone;
+
+    int promotion = (m.promotion == PIECE_TYPE_NONE)?0:m.promotion+1;
+    return (PackedMove)(m.from | (m.to << 6) | (promotion << 12));
+}
+
+inline bool same_move(const Move& a, const Move& b)
+{
+    return a.from == b.from && a.to == b.to && a.promotion == b.promotion;
+}
+
+// Creates a move structure from a UCI move string token. The move is
+// only checked to be pseudo-legal, Board::IsLegal tells whether it
+// leaves the own king in check. Returns a move of type
+// MOVE_TYPE_NONE if the string isn't a pseudo-legal move.
 Move move_from_uci(const Board& board, const std::string& move_str);
 
 std::string get_move_type(MoveType movetype);
@@ -40,4 +67,7 @@ void print_move(const Move &m);
 
 std::string move_to_algebraic(const Move &m);
 
+// Returns the move in the UCI long algebraic notation. For example "e7e8q".
+std::string move_to_uci(const Move &m);
+
 #endif //MOVE_H_
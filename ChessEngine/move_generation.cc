@@ -20,19 +20,14 @@ void Init()
 template <Side side>
 void LegalAll(const Board& board, std::vector<Move>* move_list)
 {
-	// TODO optimize this better.
     std::vector<Move> pseudo_moves;
     PseudoLegalAll<side>(board,&pseudo_moves);
 
     // Only add the moves that don't leave the king in check.
-    Board test_board = board;
-    for(Move m : pseudo_moves)
+    for(const Move& m : pseudo_moves)
     {
-        test_board.MakeMove(m);
-        if(!test_board.InCheck((Side) OPPONENT(test_board.state_.side_to_move)))
+        if(board.IsLegal(m))
             move_list->push_back(m);
-
-        test_board.UndoMove();
     }
 }
 
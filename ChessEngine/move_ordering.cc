@@ -0,0 +1,157 @@
+#include "move_ordering.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Piece values used only for ordering captures.
+    // Indexed by the Piece enum.
+    const int kOrderingValues[NUM_PIECES] = {1, 3, 3, 5, 9, 20};
+
+    inline int piece_index(PieceType piece)
+    {
+        return piece % NUM_PIECES;
+    }
+
+    // Bonus given to the history tables for a cutoff at the given depth.
+    inline int history_bonus(int depth)
+    {
+        return std::min(16 * depth * depth + 32 * depth, 1200);
+    }
+
+    inline bool valid_move(const Move& m)
+    {
+        return m.from != SQUARE_NONE && m.piece != PIECE_TYPE_NONE;
+    }
+}
+
+void Heuristics::Clear()
+{
+    std::memset(this, 0, sizeof(Heuristics));
+}
+
+void Heuristics::Age()
+{
+    std::memset(killers, 0, sizeof(killers));
+
+    for(int side = 0; side < NUM_SIDES; ++side)
+        for(int from = 0; from < NUM_SQUARES; ++from)
+            for(int to = 0; to < NUM_SQUARES; ++to)
+                history[side][from][to] /= 2;
+}
+
+namespace move_ordering
+{
+
+int quiet_history(const Heuristics& heuristics, const OrderingContext& context, const Move& m)
+{
+    int score = heuristics.history[context.side][m.from][m.to];
+
+    if(valid_move(context.previous_move))
+        score += heuristics.continuation[context.previous_move.piece][context.previous_move.to][m.piece][m.to];
+
+    if(valid_move(context.previous_move2))
+        score += heuristics.continuation[context.previous_move2.piece][context.previous_move2.to][m.piece][m.to];
+
+    return score;
+}
+
+int mvv_lva(const Move& m)
+{
+    int victim = (m.capture)?kOrderingValues[piece_index(m.captured_type)]:0;
+    int attacker = kOrderingValues[piece_index(m.piece)];
+
+    return victim * 32 - attacker;
+}
+
+void score_moves(const Heuristics& heuristics, const OrderingContext& context,
+                 const std::vector<Move>& moves, std::vector<ScoredMove>* scored)
+{
+    scored->clear();
+    scored->reserve(moves.size());
+
+    for(const Move& m : moves)
+    {
+        int score = 0;
+        PackedMove packed = pack_move(m);
+
+        if(packed == context.hash_move)
+            score = kHashMoveScore;
+        else if(m.type == PROMOTION && !piece_of_type(m.promotion, QUEENS))
+            score = kUnderPromotionScore + mvv_lva(m);
+        else if(m.capture || m.type == PROMOTION)
+            score = kGoodCaptureScore + mvv_lva(m) + ((m.type == PROMOTION)?kOrderingValues[QUEENS]*32:0);
+        else if(packed == context.killers[0])
+            score = kKillerScore1;
+        else if(packed == context.killers[1])
+            score = kKillerScore2;
+        else if(packed == context.countermove)
+            score = kCountermoveScore;
+        else
+            score = quiet_history(heuristics, context, m);
+
+        scored->push_back({m, score});
+    }
+}
+
+void score_captures(const std::vector<Move>& moves, std::vector<ScoredMove>* scored)
+{
+    scored->clear();
+
+    for(const Move& m : moves)
+    {
+        if(!m.capture && m.type != PROMOTION) continue;
+
+        // Only queen promotions are worth looking at in the quiescence search.
+        if(m.type == PROMOTION && !piece_of_type(m.promotion, QUEENS)) continue;
+
+        scored->push_back({m, mvv_lva(m)});
+    }
+}
+
+const Move& pick_next_move(std::vector<ScoredMove>* scored, int index)
+{
+    int best = index;
+    for(int i = index + 1; i < (int)scored->size(); ++i)
+    {
+        if((*scored)[i].score > (*scored)[best].score)
+            best = i;
+    }
+
+    std::swap((*scored)[index], (*scored)[best]);
+    return (*scored)[index].move;
+}
+
+void update_quiet_stats(Heuristics* heuristics, const OrderingContext& context, int ply,
+                        const Move& best_move, const std::vector<Move>& quiets_tried, int depth)
+{
+    PackedMove packed = pack_move(best_move);
+
+    if(ply < kMaxPly && heuristics->killers[ply][0] != packed)
+    {
+        heuristics->killers[ply][1] = heuristics->killers[ply][0];
+        heuristics->killers[ply][0] = packed;
+    }
+
+    if(valid_move(context.previous_move))
+        heuristics->countermoves[context.previous_move.piece][context.previous_move.to] = packed;
+
+    int bonus = history_bonus(depth);
+
+    for(const Move& m : quiets_tried)
+    {
+        int move_bonus = same_move(m, best_move)?bonus:-bonus;
+
+        update_history(&heuristics->history[context.side][m.from][m.to], move_bonus);
+
+        if(valid_move(context.previous_move))
+            update_history(&heuristics->continuation[context.previous_move.piece][context.previous_move.to][m.piece][m.to], move_bonus);
+
+        if(valid_move(context.previous_move2))
+            update_history(&heuristics->continuation[context.previous_move2.piece][context.previous_move2.to][m.piece][m.to], move_bonus);
+    }
+}
+
+}
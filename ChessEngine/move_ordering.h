@@ -0,0 +1,110 @@
+#ifndef MOVE_ORDERING_H_
+#define MOVE_ORDERING_H_
+
+#include "types.h"
+#include "move.h"
+
+#include <vector>
+
+const int kMaxPly = 128;
+
+// History values are kept in the range [-kMaxHistory, kMaxHistory]
+// by the gravity formula in update_history so they fit in 16 bits.
+const int kMaxHistory = 16384;
+
+// Move ordering tables. Every search thread owns one of these
+// so they can be updated without any synchronization.
+//
+// The history tables are stored as 16 bit values to keep the
+// tables small. The butterfly table is 16KB and the continuation
+// table about 1.2MB so this struct should be allocated on the heap.
+struct Heuristics
+{
+    // Two quiet moves per ply that caused a beta cutoff.
+    PackedMove killers[kMaxPly][2];
+
+    // Butterfly history indexed by [side][from][to].
+    int16_t history[NUM_SIDES][NUM_SQUARES][NUM_SQUARES];
+
+    // The quiet move that refuted the previous move.
+    // Indexed by [piece][to] of the previous move.
+    PackedMove countermoves[NUM_PIECE_TYPES][NUM_SQUARES];
+
+    // History of a move given the move played one or two plies
+    // earlier. Indexed by [previous piece][previous to][piece][to].
+    int16_t continuation[NUM_PIECE_TYPES][NUM_SQUARES][NUM_PIECE_TYPES][NUM_SQUARES];
+
+    void Clear();
+
+    // Shrinks the history values between searches so that
+    // the information from the previous search doesn't
+    // dominate the next one. The killers are cleared.
+    void Age();
+};
+
+// The moves played on the previous plies that are needed
+// to index the countermove and continuation history tables.
+// A null move or no move is passed as NULL_MOVE.
+struct OrderingContext
+{
+    PackedMove hash_move;
+    PackedMove killers[2];
+    PackedMove countermove;
+    Move previous_move;
+    Move previous_move2;
+    Side side;
+};
+
+struct ScoredMove
+{
+    Move move;
+    int score;
+};
+
+namespace move_ordering
+{
+    // Ordering score offsets. A move is placed in one
+    // of these bands and ordered within the band.
+    const int kHashMoveScore = 1 << 30;
+    const int kGoodCaptureScore = 1 << 28;
+    const int kKillerScore1 = 1 << 27;
+    const int kKillerScore2 = kKillerScore1 - 1;
+    const int kCountermoveScore = kKillerScore1 - 2;
+    const int kUnderPromotionScore = -(1 << 28);
+
+    // Most valuable victim, least valuable attacker score of a capture.
+    int mvv_lva(const Move& m);
+
+    // Sum of the butterfly and continuation history of a quiet move.
+    int quiet_history(const Heuristics& heuristics, const OrderingContext& context, const Move& m);
+
+    // Scores the moves and stores them in the scored list.
+    void score_moves(const Heuristics& heuristics, const OrderingContext& context,
+                     const std::vector<Move>& moves, std::vector<ScoredMove>* scored);
+
+    // Scores captures and promotions for the quiescence search.
+    void score_captures(const std::vector<Move>& moves, std::vector<ScoredMove>* scored);
+
+    // Swaps the best scored move from index onwards to index and
+    // returns it. Selection sort done lazily so that we don't
+    // waste time sorting moves that are never searched after a cutoff.
+    const Move& pick_next_move(std::vector<ScoredMove>* scored, int index);
+
+    // Updates the tables after a quiet move caused a beta cutoff.
+    // The quiet moves searched before the cutoff move get a penalty.
+    // quiets_tried should contain the cutoff move as well.
+    void update_quiet_stats(Heuristics* heuristics, const OrderingContext& context, int ply,
+                            const Move& best_move, const std::vector<Move>& quiets_tried, int depth);
+
+    // Adds a gravity scaled bonus to a history entry.
+    // The entry moves towards the bonus less the closer it
+    // already is to the limit.
+    inline void update_history(int16_t* entry, int bonus)
+    {
+        int value = *entry;
+        value += bonus - value * (bonus < 0 ? -bonus : bonus) / kMaxHistory;
+        *entry = (int16_t)value;
+    }
+}
+
+#endif // MOVE_ORDERING_H_
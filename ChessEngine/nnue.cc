@@ -0,0 +1,509 @@
+#include "nnue.h"
+#include "board.h"
+#include "bitboards.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__) || defined(__SSSE3__)
+#include <smmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nnue
+{
+
+namespace
+{
+    const uint32_t kFileVersion = 0x7AF32F16;
+
+    // Index of the first feature of each piece in the feature set
+    // of a perspective. Friendly pieces come before the enemy pieces
+    // of the same type. 0 is unused.
+    const int kPieceSquareIndex[NUM_PIECES][NUM_SIDES] =
+    {
+        {1, 1 + 64}, {1 + 128, 1 + 192}, {1 + 256, 1 + 320},
+        {1 + 384, 1 + 448}, {1 + 512, 1 + 576}, {0, 0}
+    };
+    const int kPieceSquareEnd = 1 + 640;
+    const int kInputDimensions = NUM_SQUARES * kPieceSquareEnd;
+
+    const int kTransformedDimensions = 2 * kHalfDimensions;
+    const int kHiddenDimensions = 32;
+
+    // The outputs of the hidden layers are shifted by this
+    // before clipping to stay in the range of the next layer.
+    const int kWeightScaleBits = 6;
+
+    // The network output divided by this is in the units the
+    // network was trained in, where a pawn in the endgame is
+    // about kPawnUnits.
+    const int kOutputScale = 16;
+    const int kPawnUnits = 208;
+
+    // Fully connected layer with int8 weights of uint8 inputs.
+    // The weights are stored by output.
+    struct AffineLayer
+    {
+        int inputs;
+        int outputs;
+        const int32_t *biases;
+        const int8_t *weights;
+    };
+}
+
+// Pointers into the memory mapped network file. The
+// file is unmapped when the network is destroyed.
+struct Network
+{
+    const int16_t *transformer_biases = nullptr;
+    const int16_t *transformer_weights = nullptr;
+
+    AffineLayer hidden1 = {};
+    AffineLayer hidden2 = {};
+    AffineLayer output = {};
+
+    const void *mapping = nullptr;
+    size_t mapping_size = 0;
+
+    Network() = default;
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+    ~Network();
+};
+
+namespace
+{
+    void unmap_file(const void *mapping, size_t size)
+    {
+        if(mapping == nullptr) return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(const_cast<void*>(mapping), size);
+#endif
+    }
+
+    // Returns nullptr if the file couldn't be mapped.
+    const void* map_file(const std::string& path, size_t *size)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file, &file_size);
+        *size = (size_t)file_size.QuadPart;
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if(mapping == nullptr)
+            return nullptr;
+
+        const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        return data;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd == -1)
+            return nullptr;
+
+        struct stat st;
+        if(fstat(fd, &st) == -1 || st.st_size == 0)
+        {
+            close(fd);
+            return nullptr;
+        }
+
+        *size = (size_t)st.st_size;
+        void *data = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        return (data == MAP_FAILED)?nullptr:data;
+#endif
+    }
+
+    // Reads the parts of the file in order. The file is little endian.
+    class Reader
+    {
+    public:
+        Reader(const void *data, size_t size)
+            : data_((const char*)data), size_(size), offset_(0) {}
+
+        bool ReadU32(uint32_t *value)
+        {
+            if(offset_ + sizeof(uint32_t) > size_) return false;
+            std::memcpy(value, data_ + offset_, sizeof(uint32_t));
+            offset_ += sizeof(uint32_t);
+            return true;
+        }
+
+        // Returns a pointer to count elements in the file.
+        template <typename T>
+        const T* Array(size_t count)
+        {
+            if(offset_ + count * sizeof(T) > size_) return nullptr;
+            const T* result = (const T*)(data_ + offset_);
+            offset_ += count * sizeof(T);
+            return result;
+        }
+
+        bool Skip(size_t bytes)
+        {
+            if(offset_ + bytes > size_) return false;
+            offset_ += bytes;
+            return true;
+        }
+
+        bool AtEnd() const {return offset_ == size_;}
+
+    private:
+        const char *data_;
+        size_t size_;
+        size_t offset_;
+    };
+
+    bool read_layer(Reader *reader, int inputs, int outputs, AffineLayer *layer)
+    {
+        layer->inputs = inputs;
+        layer->outputs = outputs;
+        layer->biases = reader->Array<int32_t>(outputs);
+        layer->weights = reader->Array<int8_t>(inputs * outputs);
+        return layer->biases && layer->weights;
+    }
+
+    bool read_network(Reader *reader, Network *result)
+    {
+        uint32_t version, hash, description_size;
+        if(!reader->ReadU32(&version) || version != kFileVersion) return false;
+        if(!reader->ReadU32(&hash) || !reader->ReadU32(&description_size)) return false;
+        if(!reader->Skip(description_size)) return false;
+
+        // Feature transformer.
+        if(!reader->ReadU32(&hash)) return false;
+        result->transformer_biases = reader->Array<int16_t>(kHalfDimensions);
+        result->transformer_weights = reader->Array<int16_t>((size_t)kHalfDimensions * kInputDimensions);
+        if(!result->transformer_biases || !result->transformer_weights) return false;
+
+        // Hidden and output layers.
+        if(!reader->ReadU32(&hash)) return false;
+        if(!read_layer(reader, kTransformedDimensions, kHiddenDimensions, &result->hidden1)) return false;
+        if(!read_layer(reader, kHiddenDimensions, kHiddenDimensions, &result->hidden2)) return false;
+        if(!read_layer(reader, kHiddenDimensions, 1, &result->output)) return false;
+
+        return reader->AtEnd();
+    }
+
+    // Squares are numbered from A1 in the network, and
+    // the board is rotated for the black perspective.
+    inline int orient(Side perspective, Square square)
+    {
+        int network_square = square ^ 56;
+        return (perspective == WHITE)?network_square:network_square ^ 63;
+    }
+
+    inline int feature_index(Side perspective, Square king_square, PieceType piece, Square square)
+    {
+        int type = piece % NUM_PIECES;
+        int relative = ((piece / NUM_PIECES) == perspective)?0:1;
+
+        return orient(perspective, square)
+            + kPieceSquareIndex[type][relative]
+            + kPieceSquareEnd * orient(perspective, king_square);
+    }
+
+    // The weights of a feature are not aligned in the mapped
+    // file so the vector kernels use unaligned loads.
+    inline void add_feature(const Network& network, int16_t *values, int index)
+    {
+        const int16_t *column = network.transformer_weights + (size_t)index * kHalfDimensions;
+
+#if defined(__AVX2__)
+        for(int i = 0; i < kHalfDimensions; i += 16)
+        {
+            __m256i v = _mm256_load_si256((const __m256i*)(values + i));
+            __m256i w = _mm256_loadu_si256((const __m256i*)(column + i));
+            _mm256_store_si256((__m256i*)(values + i), _mm256_add_epi16(v, w));
+        }
+#elif defined(__SSE4_1__) || defined(__SSSE3__)
+        for(int i = 0; i < kHalfDimensions; i += 8)
+        {
+            __m128i v = _mm_load_si128((const __m128i*)(values + i));
+            __m128i w = _mm_loadu_si128((const __m128i*)(column + i));
+            _mm_store_si128((__m128i*)(values + i), _mm_add_epi16(v, w));
+        }
+#else
+        for(int i = 0; i < kHalfDimensions; ++i)
+            values[i] += column[i];
+#endif
+    }
+
+    inline void remove_feature(const Network& network, int16_t *values, int index)
+    {
+        const int16_t *column = network.transformer_weights + (size_t)index * kHalfDimensions;
+
+#if defined(__AVX2__)
+        for(int i = 0; i < kHalfDimensions; i += 16)
+        {
+            __m256i v = _mm256_load_si256((const __m256i*)(values + i));
+            __m256i w = _mm256_loadu_si256((const __m256i*)(column + i));
+            _mm256_store_si256((__m256i*)(values + i), _mm256_sub_epi16(v, w));
+        }
+#elif defined(__SSE4_1__) || defined(__SSSE3__)
+        for(int i = 0; i < kHalfDimensions; i += 8)
+        {
+            __m128i v = _mm_load_si128((const __m128i*)(values + i));
+            __m128i w = _mm_loadu_si128((const __m128i*)(column + i));
+            _mm_store_si128((__m128i*)(values + i), _mm_sub_epi16(v, w));
+        }
+#else
+        for(int i = 0; i < kHalfDimensions; ++i)
+            values[i] -= column[i];
+#endif
+    }
+
+    inline Square king_square(const Board& board, Side side)
+    {
+        return square_from_bitboard(board.pieces_[(side == WHITE)?WHITE_KING:BLACK_KING]);
+    }
+
+    // Calculates the accumulator of the perspective from scratch.
+    void refresh(const Network& network, const Board& board, Accumulator *accumulator, Side perspective)
+    {
+        int16_t *values = accumulator->values[perspective];
+        std::memcpy(values, network.transformer_biases, sizeof(int16_t) * kHalfDimensions);
+
+        Square king = king_square(board, perspective);
+
+        for(int piece = WHITE_PAWNS; piece < NUM_PIECE_TYPES; ++piece)
+        {
+            if(piece == WHITE_KING || piece == BLACK_KING) continue;
+
+            Bitboard bitboard = board.pieces_[piece];
+            while(bitboard)
+            {
+                Square square = PopLSB(&bitboard);
+                add_feature(network, values, feature_index(perspective, king, (PieceType)piece, square));
+            }
+        }
+
+        accumulator->computed[perspective] = true;
+    }
+
+    // Updates the accumulator from the previous ply's accumulator.
+    void update(const Network& network, const Accumulator& previous, Accumulator *accumulator, Side perspective, Square king)
+    {
+        int16_t *values = accumulator->values[perspective];
+        std::memcpy(values, previous.values[perspective], sizeof(int16_t) * kHalfDimensions);
+
+        const DirtyPieces& dirty = accumulator->dirty;
+        for(int i = 0; i < dirty.count; ++i)
+        {
+            // The kings are not features. Only the enemy 
+            // king can have moved, as the own king didn't.
+            if(dirty.piece[i] % NUM_PIECES == KINGS) continue;
+
+            if(dirty.from[i] != SQUARE_NONE)
+                remove_feature(network, values, feature_index(perspective, king, dirty.piece[i], dirty.from[i]));
+            if(dirty.to[i] != SQUARE_NONE)
+                add_feature(network, values, feature_index(perspective, king, dirty.piece[i], dirty.to[i]));
+        }
+
+        accumulator->computed[perspective] = true;
+    }
+
+    inline bool king_moved(const DirtyPieces& dirty, Side perspective)
+    {
+        PieceType king = (perspective == WHITE)?WHITE_KING:BLACK_KING;
+        for(int i = 0; i < dirty.count; ++i)
+            if(dirty.piece[i] == king) return true;
+        return false;
+    }
+
+    // Brings the accumulator of the current ply up to date by applying
+    // the moves made since the last computed accumulator. A king move
+    // changes every feature of its side so that side is refreshed.
+    void update_accumulators(const Network& network, const Board& board)
+    {
+        Accumulator *stack = board.accumulators_.data();
+        size_t top = board.accumulator_top_;
+
+        for(int side = WHITE; side < NUM_SIDES; ++side)
+        {
+            Side perspective = (Side)side;
+            if(stack[top].computed[perspective]) continue;
+
+            size_t base = top;
+            bool needs_refresh = false;
+
+            while(!stack[base].computed[perspective])
+            {
+                if(base == 0 || king_moved(stack[base].dirty, perspective))
+                {
+                    needs_refresh = true;
+                    break;
+                }
+                --base;
+            }
+
+            if(needs_refresh)
+            {
+                refresh(network, board, &stack[top], perspective);
+                continue;
+            }
+
+            Square king = king_square(board, perspective);
+            for(size_t i = base + 1; i <= top; ++i)
+                update(network, stack[i - 1], &stack[i], perspective, king);
+        }
+    }
+
+    // Clamps the accumulators to [0, 127], side to move first.
+    void transform(const Accumulator& accumulator, Side side, uint8_t *output)
+    {
+        Side perspectives[2] = {side, (side == WHITE)?BLACK:WHITE};
+
+        for(int p = 0; p < 2; ++p)
+        {
+            const int16_t *values = accumulator.values[perspectives[p]];
+            uint8_t *out = output + p * kHalfDimensions;
+
+#if defined(__AVX2__)
+            for(int i = 0; i < kHalfDimensions; i += 32)
+            {
+                __m256i a = _mm256_load_si256((const __m256i*)(values + i));
+                __m256i b = _mm256_load_si256((const __m256i*)(values + i + 16));
+
+                // packs interleaves the 128 bit lanes of a and b.
+                __m256i packed = _mm256_packs_epi16(a, b);
+                packed = _mm256_max_epi8(packed, _mm256_setzero_si256());
+                packed = _mm256_permute4x64_epi64(packed, 0xD8);
+                _mm256_store_si256((__m256i*)(out + i), packed);
+            }
+#elif defined(__SSE4_1__)
+            for(int i = 0; i < kHalfDimensions; i += 16)
+            {
+                __m128i a = _mm_load_si128((const __m128i*)(values + i));
+                __m128i b = _mm_load_si128((const __m128i*)(values + i + 8));
+                __m128i packed = _mm_max_epi8(_mm_packs_epi16(a, b), _mm_setzero_si128());
+                _mm_store_si128((__m128i*)(out + i), packed);
+            }
+#else
+            for(int i = 0; i < kHalfDimensions; ++i)
+                out[i] = (uint8_t)std::max(0, std::min(127, (int)values[i]));
+#endif
+        }
+    }
+
+    // The input size of the layers is a multiple of 32.
+    void affine(const AffineLayer& layer, const uint8_t *input, int32_t *output)
+    {
+        for(int o = 0; o < layer.outputs; ++o)
+        {
+            const int8_t *row = layer.weights + o * layer.inputs;
+
+#if defined(__AVX2__)
+            const __m256i ones = _mm256_set1_epi16(1);
+            __m256i sum = _mm256_setzero_si256();
+
+            for(int i = 0; i < layer.inputs; i += 32)
+            {
+                __m256i in = _mm256_load_si256((const __m256i*)(input + i));
+                __m256i w = _mm256_loadu_si256((const __m256i*)(row + i));
+                __m256i product = _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones);
+                sum = _mm256_add_epi32(sum, product);
+            }
+
+            __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+            sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+            output[o] = layer.biases[o] + _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE4_1__) || defined(__SSSE3__)
+            const __m128i ones = _mm_set1_epi16(1);
+            __m128i sum = _mm_setzero_si128();
+
+            for(int i = 0; i < layer.inputs; i += 16)
+            {
+                __m128i in = _mm_load_si128((const __m128i*)(input + i));
+                __m128i w = _mm_loadu_si128((const __m128i*)(row + i));
+                __m128i product = _mm_madd_epi16(_mm_maddubs_epi16(in, w), ones);
+                sum = _mm_add_epi32(sum, product);
+            }
+
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+            output[o] = layer.biases[o] + _mm_cvtsi128_si32(sum);
+#else
+            int32_t sum = layer.biases[o];
+            for(int i = 0; i < layer.inputs; ++i)
+                sum += (int32_t)input[i] * row[i];
+            output[o] = sum;
+#endif
+        }
+    }
+
+    void clipped_relu(const int32_t *input, int size, uint8_t *output)
+    {
+        for(int i = 0; i < size; ++i)
+            output[i] = (uint8_t)std::max(0, std::min(127, input[i] >> kWeightScaleBits));
+    }
+}
+
+Network::~Network()
+{
+    unmap_file(mapping, mapping_size);
+}
+
+std::shared_ptr<const Network> load(const std::string& path)
+{
+    auto network = std::make_shared<Network>();
+
+    network->mapping = map_file(path, &network->mapping_size);
+    if(network->mapping == nullptr)
+        return nullptr;
+
+    Reader reader(network->mapping, network->mapping_size);
+    if(!read_network(&reader, network.get()))
+        return nullptr;
+
+    return network;
+}
+
+int evaluate(const Network& network, const Board& board)
+{
+    update_accumulators(network, board);
+
+    alignas(32) uint8_t transformed[kTransformedDimensions];
+    alignas(32) int32_t hidden_sums[kHiddenDimensions];
+    alignas(32) uint8_t hidden1[kHiddenDimensions];
+    alignas(32) uint8_t hidden2[kHiddenDimensions];
+    int32_t output;
+
+    transform(board.accumulators_[board.accumulator_top_], board.SideToMove(), transformed);
+
+    affine(network.hidden1, transformed, hidden_sums);
+    clipped_relu(hidden_sums, kHiddenDimensions, hidden1);
+
+    affine(network.hidden2, hidden1, hidden_sums);
+    clipped_relu(hidden_sums, kHiddenDimensions, hidden2);
+
+    affine(network.output, hidden2, &output);
+
+    return output * 100 / (kOutputScale * kPawnUnits);
+}
+
+}
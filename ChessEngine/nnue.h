@@ -0,0 +1,64 @@
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include "types.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class Board;
+
+// Efficiently updatable neural network evaluation.
+//
+// The network uses the HalfKP feature set: every non-king piece
+// is a feature relative to the square of the king of each side.
+// The first layer is kept up to date incrementally for both
+// sides in the accumulators. The remaining layers are small
+// and calculated on every evaluation.
+//
+// Architecture: 41024 -> 2 x 256 -> 32 -> 32 -> 1.
+namespace nnue
+{
+
+const int kHalfDimensions = 256;
+
+// Pieces that changed in a move. A removed piece
+// has to set to SQUARE_NONE and an added piece has 
+// from set to SQUARE_NONE.
+struct DirtyPieces
+{
+    int count;
+    PieceType piece[3];
+    Square from[3];
+    Square to[3];
+};
+
+// Output of the first layer for both perspectives. The board
+// keeps one for each ply and updates them lazily when the
+// position is evaluated.
+struct alignas(32) Accumulator
+{
+    int16_t values[NUM_SIDES][kHalfDimensions];
+    bool computed[NUM_SIDES];
+
+    // Changes made by the move that led to this position.
+    DirtyPieces dirty;
+};
+
+// Weights of a loaded network. They are never modified, so a
+// network can be shared by any number of boards and threads.
+struct Network;
+
+// Loads the network from a file in the .nnue format. The file
+// is memory mapped until the last reference to the network is
+// released. Returns nullptr if the file couldn't be loaded.
+std::shared_ptr<const Network> load(const std::string& path);
+
+// Returns the evaluation in centipawns from the side to
+// move's point of view. The board's accumulators are updated.
+int evaluate(const Network& network, const Board& board);
+
+}
+
+#endif // NNUE_H_
@@ -0,0 +1,154 @@
+#include "options.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace
+{
+    bool equal_case_insensitive(const std::string& a, const std::string& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+            [](char x, char y){ return std::tolower((unsigned char)x) == std::tolower((unsigned char)y); });
+    }
+
+    bool parse_int(const std::string& value, int *result)
+    {
+        std::istringstream iss(value);
+        int parsed;
+        if(!(iss >> parsed) || !iss.eof())
+            return false;
+
+        *result = parsed;
+        return true;
+    }
+}
+
+int Option::IntValue() const
+{
+    int result = 0;
+    parse_int(value, &result);
+    return result;
+}
+
+bool Option::BoolValue() const
+{
+    return value == "true";
+}
+
+void Options::AddSpin(const std::string& name, int default_value, int min, int max,
+                      std::function<void(const Option&)> on_change)
+{
+    std::string value = std::to_string(default_value);
+    options_.push_back({name, OPTION_SPIN, value, value, min, max, on_change});
+}
+
+void Options::AddCheck(const std::string& name, bool default_value,
+                       std::function<void(const Option&)> on_change)
+{
+    std::string value = default_value?"true":"false";
+    options_.push_back({name, OPTION_CHECK, value, value, 0, 0, on_change});
+}
+
+void Options::AddString(const std::string& name, const std::string& default_value,
+                        std::function<void(const Option&)> on_change)
+{
+    options_.push_back({name, OPTION_STRING, default_value, default_value, 0, 0, on_change});
+}
+
+void Options::AddButton(const std::string& name, std::function<void(const Option&)> on_change)
+{
+    options_.push_back({name, OPTION_BUTTON, "", "", 0, 0, on_change});
+}
+
+bool Options::Set(const std::string& name, const std::string& value, std::string* error)
+{
+    Option *option = FindOption(name);
+    if(option == nullptr)
+    {
+        *error = "No such option: " + name;
+        return false;
+    }
+
+    switch(option->type)
+    {
+        case OPTION_SPIN:
+        {
+            int parsed;
+            if(!parse_int(value, &parsed) || parsed < option->min || parsed > option->max)
+            {
+                *error = "Invalid value for " + option->name + ": " + value;
+                return false;
+            }
+            option->value = std::to_string(parsed);
+            break;
+        }
+        case OPTION_CHECK:
+        {
+            if(value != "true" && value != "false")
+            {
+                *error = "Invalid value for " + option->name + ": " + value;
+                return false;
+            }
+            option->value = value;
+            break;
+        }
+        case OPTION_STRING:
+            option->value = value;
+            break;
+        case OPTION_BUTTON:
+            break;
+    }
+
+    if(option->on_change)
+        option->on_change(*option);
+
+    return true;
+}
+
+const Option* Options::Find(const std::string& name) const
+{
+    for(const Option& option : options_)
+    {
+        if(equal_case_insensitive(option.name, name))
+            return &option;
+    }
+    return nullptr;
+}
+
+Option* Options::FindOption(const std::string& name)
+{
+    return const_cast<Option*>(Find(name));
+}
+
+std::vector<std::string> Options::UciDescriptions() const
+{
+    std::vector<std::string> lines;
+
+    for(const Option& option : options_)
+    {
+        std::string line = "option name " + option.name + " type ";
+
+        switch(option.type)
+        {
+            case OPTION_SPIN:
+                line += "spin default " + option.default_value 
+                      + " min " + std::to_string(option.min) 
+                      + " max " + std::to_string(option.max);
+                break;
+            case OPTION_CHECK:
+                line += "check default " + option.default_value;
+                break;
+            case OPTION_STRING:
+                line += "string default " + (option.default_value.empty()?std::string("<empty>"):option.default_value);
+                break;
+            case OPTION_BUTTON:
+                line += "button";
+                break;
+        }
+
+        lines.push_back(line);
+    }
+
+    return lines;
+}
@@ -0,0 +1,69 @@
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+enum OptionType
+{
+    OPTION_SPIN,
+    OPTION_CHECK,
+    OPTION_STRING,
+    OPTION_BUTTON
+};
+
+// An option that can be changed with the UCI setoption command.
+struct Option
+{
+    std::string name;
+    OptionType type;
+    std::string default_value;
+    std::string value;
+
+    // Range of spin options.
+    int min;
+    int max;
+
+    // Called after the value has been changed.
+    std::function<void(const Option&)> on_change;
+
+    int IntValue() const;
+    bool BoolValue() const;
+};
+
+// The options of the engine in the order they were added.
+// The names are matched case insensitively like the UCI
+// protocol requires.
+class Options
+{
+public:
+    void AddSpin(const std::string& name, int default_value, int min, int max,
+                 std::function<void(const Option&)> on_change = nullptr);
+
+    void AddCheck(const std::string& name, bool default_value,
+                  std::function<void(const Option&)> on_change = nullptr);
+
+    void AddString(const std::string& name, const std::string& default_value,
+                   std::function<void(const Option&)> on_change = nullptr);
+
+    void AddButton(const std::string& name, std::function<void(const Option&)> on_change);
+
+    // Validates and sets the value of the option and calls its
+    // on_change callback. Returns false and sets error if the
+    // option doesn't exist or the value is invalid.
+    bool Set(const std::string& name, const std::string& value, std::string* error);
+
+    // Returns nullptr if there is no option with the name.
+    const Option* Find(const std::string& name) const;
+
+    // Returns the option lines sent as a response to the uci command.
+    std::vector<std::string> UciDescriptions() const;
+
+private:
+    Option* FindOption(const std::string& name);
+
+    std::vector<Option> options_;
+};
+
+#endif // OPTIONS_H_
@@ -0,0 +1,38 @@
+#include "output.h"
+
+#include <cstdio>
+#include <mutex>
+
+namespace
+{
+    std::mutex output_mutex;
+    std::string buffer;
+}
+
+namespace output
+{
+
+void write_line(const std::string& line)
+{
+    std::lock_guard<std::mutex> lock(output_mutex);
+    buffer += line;
+    buffer += '\n';
+}
+
+void flush()
+{
+    std::lock_guard<std::mutex> lock(output_mutex);
+    if(buffer.empty()) return;
+
+    std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+    std::fflush(stdout);
+    buffer.clear();
+}
+
+void send(const std::string& line)
+{
+    write_line(line);
+    flush();
+}
+
+}
@@ -0,0 +1,26 @@
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <string>
+
+// Buffered output for the UCI protocol. 
+//
+// Lines from the UCI and search threads are collected 
+// in a buffer and written to stdout only when flush is 
+// called, at points where the GUI is waiting for a 
+// response (uciok, readyok, info after an iteration, bestmove)
+// and after the info string errors of the UCI commands.
+namespace output
+{
+    // Appends a line to the buffer. A newline is added to the line.
+    // Safe to call from any thread.
+    void write_line(const std::string& line);
+
+    // Writes the buffered lines to stdout.
+    void flush();
+
+    // Convenience function for write_line followed by flush.
+    void send(const std::string& line);
+}
+
+#endif // OUTPUT_H_
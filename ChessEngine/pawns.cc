@@ -0,0 +1,195 @@
+#include "pawns.h"
+#include "bitboards.h"
+
+#include <algorithm>
+
+namespace
+{
+    const Score kDoubledPawn = {-10, -25};
+    const Score kIsolatedPawn = {-6, -14};
+    const Score kBackwardPawn = {-8, -10};
+
+    // Indexed by the rank of the pawn from its own side's point of view.
+    const Score kPassedPawn[NUM_RANKS] = 
+    {
+        {0, 0}, {0, 5}, {0, 10}, {5, 15}, {15, 30}, {30, 55}, {50, 90}, {0, 0}
+    };
+
+    // Bonus for each pawn on the king's file or the adjacent files
+    // one and two ranks in front of the king.
+    const Score kShieldPawn[2] = {{15, 0}, {8, 0}};
+
+    // The bit of A8 is the most significant bit, so 
+    // shifting left moves the pawns towards rank 8.
+    inline Bitboard north_fill(Bitboard b)
+    {
+        b |= b << 8;
+        b |= b << 16;
+        b |= b << 32;
+        return b;
+    }
+
+    inline Bitboard south_fill(Bitboard b)
+    {
+        b |= b >> 8;
+        b |= b >> 16;
+        b |= b >> 32;
+        return b;
+    }
+
+    inline Bitboard shift_east(Bitboard b) {return (b >> 1) & ~kBitboardFileA;}
+    inline Bitboard shift_west(Bitboard b) {return (b << 1) & ~kBitboardFileH;}
+
+    inline Bitboard adjacent_files(Bitboard files)
+    {
+        return shift_east(files) | shift_west(files);
+    }
+
+    template <Side side>
+    inline Bitboard forward(Bitboard b)
+    {
+        return (side == WHITE)?(b << 8):(b >> 8);
+    }
+
+    template <Side side>
+    inline Bitboard forward_fill(Bitboard b)
+    {
+        return (side == WHITE)?north_fill(b):south_fill(b);
+    }
+
+    template <Side side>
+    inline Bitboard pawn_attacks(Bitboard pawns)
+    {
+        Bitboard front = forward<side>(pawns);
+        return shift_east(front) | shift_west(front);
+    }
+
+    template <Side side>
+    inline int relative_rank(Square square)
+    {
+        int rank = NUM_RANKS - 1 - square / NUM_FILES;
+        return (side == WHITE)?rank:NUM_RANKS - 1 - rank;
+    }
+
+    // Evaluates the pawns of one side set-wise. Returns the score
+    // from the side's point of view.
+    template <Side side>
+    Score evaluate_side(const Board& board, PawnEntry *entry)
+    {
+        const Side opponent = (side == WHITE)?BLACK:WHITE;
+
+        Bitboard pawns = board.pieces_[(side == WHITE)?WHITE_PAWNS:BLACK_PAWNS];
+        Bitboard enemy_pawns = board.pieces_[(side == WHITE)?BLACK_PAWNS:WHITE_PAWNS];
+
+        Bitboard enemy_front_spans = forward_fill<opponent>(forward<opponent>(enemy_pawns));
+        Bitboard enemy_attack_spans = adjacent_files(enemy_front_spans);
+
+        // A pawn is passed when no enemy pawn can stop it 
+        // or capture it on its way to promotion.
+        Bitboard passed = pawns & ~(enemy_front_spans | enemy_attack_spans);
+        
+        // Pawns with a friendly pawn behind them on the same file.
+        Bitboard doubled = pawns & forward_fill<side>(forward<side>(pawns));
+
+        Bitboard files = north_fill(pawns) | south_fill(pawns);
+        Bitboard isolated = pawns & ~adjacent_files(files);
+
+        // A pawn is backward when it can't advance without being
+        // captured by a pawn and no friendly pawn can defend it.
+        Bitboard attack_span = forward_fill<side>(entry->pawn_attacks[side]);
+        Bitboard stops = forward<side>(pawns) & entry->pawn_attacks[opponent] & ~attack_span;
+        Bitboard backward = forward<opponent>(stops) & ~isolated;
+
+        entry->passed_pawns[side] = passed;
+
+        Score score = kDoubledPawn * PopulationCount(doubled)
+                    + kIsolatedPawn * PopulationCount(isolated)
+                    + kBackwardPawn * PopulationCount(backward);
+
+        while(passed)
+        {
+            Square square = PopLSB(&passed);
+            score += kPassedPawn[relative_rank<side>(square)];
+        }
+
+        return score;
+    }
+
+    template <Side side>
+    Score evaluate_shield(const Board& board, Square king_square)
+    {
+        Bitboard pawns = board.pieces_[(side == WHITE)?WHITE_PAWNS:BLACK_PAWNS];
+
+        Bitboard king = bb_from_square(king_square);
+        Bitboard files = king | shift_east(king) | shift_west(king);
+
+        Bitboard first = forward<side>(files);
+        Bitboard second = forward<side>(first);
+
+        return kShieldPawn[0] * PopulationCount(pawns & first)
+             + kShieldPawn[1] * PopulationCount(pawns & second & ~forward<side>(pawns & first));
+    }
+}
+
+Score PawnEntry::KingShield(const Board& board, Side side)
+{
+    Square king_square = square_from_bitboard(board.pieces_[(side == WHITE)?WHITE_KING:BLACK_KING]);
+
+    if(king_squares[side] != king_square)
+    {
+        king_squares[side] = king_square;
+        shield[side] = (side == WHITE)?evaluate_shield<WHITE>(board,king_square)
+                                      :evaluate_shield<BLACK>(board,king_square);
+    }
+
+    return shield[side];
+}
+
+PawnTable::PawnTable(int size)
+    : entries_(size)
+{
+    Clear();
+}
+
+void PawnTable::Clear()
+{
+    // Key 0 is the position without pawns so the empty 
+    // entries have to be valid entries of that position.
+    PawnEntry empty;
+    empty.key = 0;
+    pawns::evaluate_pawn_structure(Board(), &empty);
+
+    std::fill(entries_.begin(), entries_.end(), empty);
+}
+
+PawnEntry* PawnTable::Probe(const Board& board)
+{
+    u64 key = board.state_.pawn_hash;
+    PawnEntry *entry = &entries_[key & (entries_.size() - 1)];
+
+    if(entry->key == key)
+        return entry;
+
+    entry->key = key;
+    pawns::evaluate_pawn_structure(board, entry);
+    return entry;
+}
+
+namespace pawns
+{
+
+void evaluate_pawn_structure(const Board& board, PawnEntry *entry)
+{
+    entry->pawn_attacks[WHITE] = pawn_attacks<WHITE>(board.pieces_[WHITE_PAWNS]);
+    entry->pawn_attacks[BLACK] = pawn_attacks<BLACK>(board.pieces_[BLACK_PAWNS]);
+
+    entry->score = evaluate_side<WHITE>(board, entry) - evaluate_side<BLACK>(board, entry);
+
+    // The shields are calculated when they are first needed.
+    entry->king_squares[WHITE] = SQUARE_NONE;
+    entry->king_squares[BLACK] = SQUARE_NONE;
+    entry->shield[WHITE] = {0, 0};
+    entry->shield[BLACK] = {0, 0};
+}
+
+}
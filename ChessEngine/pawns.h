@@ -0,0 +1,59 @@
+#ifndef PAWNS_H_
+#define PAWNS_H_
+
+#include "board.h"
+
+#include <vector>
+
+// Pawn structure evaluation of a position. Only depends on the
+// pawns, except for the pawn shield which also depends on the
+// king squares and is recalculated when a king moves.
+struct PawnEntry
+{
+    u64 key;
+
+    // Passed, isolated, doubled and backward pawn 
+    // terms from white's point of view.
+    Score score;
+
+    Bitboard passed_pawns[NUM_SIDES];
+
+    // Squares attacked by the pawns of each side.
+    Bitboard pawn_attacks[NUM_SIDES];
+
+    // Pawn shield of the king on king_squares[side].
+    Square king_squares[NUM_SIDES];
+    Score shield[NUM_SIDES];
+
+    // Returns the pawn shield score of the side's king.
+    Score KingShield(const Board& board, Side side);
+};
+
+const int kDefaultPawnTableSize = 16384;
+
+// Every search thread has its own pawn table so that it 
+// can be accessed without synchronization. The pawn structure 
+// changes rarely between nodes so almost all probes hit.
+class PawnTable
+{
+public:
+    // The size is the number of entries and must be a power of two.
+    PawnTable(int size = kDefaultPawnTableSize);
+
+    void Clear();
+
+    // Returns the entry of the pawn structure of the 
+    // board. The entry is calculated if it's not in the table.
+    PawnEntry* Probe(const Board& board);
+
+private:
+    std::vector<PawnEntry> entries_;
+};
+
+namespace pawns
+{
+    // Calculates the pawn structure terms of the board into the entry.
+    void evaluate_pawn_structure(const Board& board, PawnEntry *entry);
+}
+
+#endif // PAWNS_H_
@@ -4,92 +4,1046 @@
 #include "transposition.h"
 #include "types.h"
 #include "util.h"
+#include "output.h"
 
 #include <iostream>
+#include <sstream>
 #include <algorithm> // for std::min and std::max
 #include <cmath>
 #include <limits>
+#include <thread>
+#include <map>
 
-//TranspositionTable transposition_table;
+namespace
+{
+	const int kInfinite = evaluation::kMateScore + 1;
+
+	// Scores above this are mate scores.
+	const int kMateInMaxPly = evaluation::kMateScore - kMaxPly;
+
+	// How often the main thread checks the clock.
+	const u64 kCheckNodesInterval = 2048;
+
+	// Number of moves the remaining time is divided 
+	// between when the GUI doesn't send movestogo.
+	const int kDefaultMovesToGo = 30;
+
+	// The evaluation is looked up from the thread's eval cache 
+	// first. Positions recur often through transpositions and 
+	// the re-searches of iterative deepening.
+	int static_evaluation(SearchThread *thread)
+	{
+		u64 hash = thread->board.state_.hash;
+
+		int score;
+		if(thread->eval_cache.Probe(hash, &score))
+			return score;
+
+		score = evaluation::evaluate(thread->board, &thread->pawn_table, &thread->material_table);
+		thread->eval_cache.Store(hash, score);
+		return score;
+	}
+
+	void generate_moves(const Board& board, std::vector<Move>* moves)
+	{
+		moves->clear();
+
+		if(board.SideToMove() == WHITE)
+			move_generation::PseudoLegalAll<WHITE>(board,moves);
+		else
+			move_generation::PseudoLegalAll<BLACK>(board,moves);
+	}
+
+	int elapsed_ms(const Search *search)
+	{
+		auto elapsed = std::chrono::steady_clock::now() - search->start_time;
+		return (int)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+	}
+
+	// Only the owning thread writes the counter so a 
+	// relaxed load and store is enough.
+	inline u64 count_node(SearchThread *thread)
+	{
+		u64 nodes = thread->nodes.load(std::memory_order_relaxed) + 1;
+		thread->nodes.store(nodes,std::memory_order_relaxed);
+		return nodes;
+	}
+
+	// Checks the limits of the search. The stop flag is checked on
+	// every node and the clock every kCheckNodesInterval nodes.
+	// Only the main thread checks the time and node limits.
+	// Returns true if the search should be stopped.
+	bool check_limits(Search *search, SearchThread *thread, u64 nodes)
+	{
+		// The duration is adjusted before ponder is cleared.
+		if(thread->id == 0 && nodes % kCheckNodesInterval == 0 
+			&& !search->ponder.load(std::memory_order_acquire))
+		{
+			bool out_of_time = search->duration > 0 && elapsed_ms(search) >= search->duration;
+			bool out_of_nodes = search->nodes > 0 && NodesSearched(search) >= search->nodes;
+
+			if(out_of_time || out_of_nodes)
+				TerminateSearch(search,true);
+		}
+
+		thread->stopped = SearchStopped(search);
+		return thread->stopped;
+	}
+
+	// Mate scores are stored in the transposition table relative
+	// to the position instead of the root.
+	inline int score_to_tt(int score, int ply)
+	{
+		if(score > kMateInMaxPly) return score + ply;
+		if(score < -kMateInMaxPly) return score - ply;
+		return score;
+	}
+
+	inline int score_from_tt(int score, int ply)
+	{
+		if(score > kMateInMaxPly) return score - ply;
+		if(score < -kMateInMaxPly) return score + ply;
+		return score;
+	}
+
+	// Helper threads skip some depths so that the threads
+	// are spread over different depths instead of all 
+	// searching the same tree.
+	const int kSkipSize[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+	const int kSkipPhase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+	const int kSkipPatterns = sizeof(kSkipSize) / sizeof(kSkipSize[0]);
+
+	bool skip_depth(const SearchThread *thread, int depth)
+	{
+		if(thread->id == 0) return false;
+
+		int i = (thread->id - 1) % kSkipPatterns;
+		return ((depth + kSkipPhase[i]) / kSkipSize[i]) % 2 != 0;
+	}
+
+	// Picks the thread whose best move got the most votes. Each thread
+	// votes for its move weighted by its score and completed depth.
+	SearchThread* best_thread(Search *search)
+	{
+		SearchThread *best = search->threads[0].get();
+
+		// Only the main thread searches all the lines.
+		if(search->threads.size() == 1 || search->multi_pv > 1)
+			return best;
+
+		int min_score = kInfinite;
+		for(auto& thread : search->threads)
+		{
+			if(thread->completed_depth > 0)
+				min_score = std::min(min_score,thread->best_score);
+		}
+
+		std::map<PackedMove,long long> votes;
+		for(auto& thread : search->threads)
+		{
+			if(thread->completed_depth == 0) continue;
+			votes[pack_move(thread->root_best_move)] += 
+				(long long)(thread->best_score - min_score + 14) * thread->completed_depth;
+		}
+
+		for(auto& thread : search->threads)
+		{
+			if(thread->completed_depth == 0) continue;
+
+			PackedMove move = pack_move(thread->root_best_move);
+			PackedMove best_move = pack_move(best->root_best_move);
+			if(votes[move] > votes[best_move] 
+				|| (votes[move] == votes[best_move] && thread->completed_depth > best->completed_depth))
+				best = thread.get();
+		}
+
+		return best;
+	}
+
+	OrderingContext ordering_context(const SearchThread *thread, int ply, PackedMove hash_move)
+	{
+		OrderingContext context;
+		const Heuristics& heuristics = thread->heuristics;
+
+		context.side = thread->board.SideToMove();
+		context.hash_move = hash_move;
+		context.killers[0] = heuristics.killers[ply][0];
+		context.killers[1] = heuristics.killers[ply][1];
+		context.previous_move = (ply >= 1)?thread->stack[ply-1].current_move:Move(NULL_MOVE);
+		context.previous_move2 = (ply >= 2)?thread->stack[ply-2].current_move:Move(NULL_MOVE);
+
+		const Move& previous = context.previous_move;
+		context.countermove = (previous.piece != PIECE_TYPE_NONE)
+			?heuristics.countermoves[previous.piece][previous.to]
+			:kPackedMoveNone;
+
+		return context;
+	}
+
+	void init_reductions(Search *search)
+	{
+		const SearchParameters& params = search->params;
+
+		for(int depth = 0; depth < kMaxPly; ++depth)
+		{
+			for(int moves = 0; moves < kMaxReductionMoves; ++moves)
+			{
+				if(depth == 0 || moves == 0)
+				{
+					search->reductions[depth][moves] = 0;
+					continue;
+				}
+
+				search->reductions[depth][moves] = 
+					(int)(params.lmr_base + std::log(depth) * std::log(moves) / params.lmr_divisor);
+			}
+		}
+	}
+
+	void update_pv(SearchThread *thread, int ply, const Move& move)
+	{
+		thread->pv[ply][ply] = move;
+		for(int i = ply + 1; i < thread->pv_length[ply + 1]; ++i)
+			thread->pv[ply][i] = thread->pv[ply + 1][i];
+
+		thread->pv_length[ply] = thread->pv_length[ply + 1];
+	}
+
+	// Reports the first lines of the root moves.
+	void print_info(Search *search, const SearchThread *thread, int depth, int lines)
+	{
+		if(search->silent && !search->info_callback)
+			return;
+
+		int time = elapsed_ms(search);
+		u64 nodes = NodesSearched(search);
+		u64 nps = (time > 0)?(nodes * 1000 / time):nodes;
+		int hashfull = search->transposition_table.Hashfull();
+
+		for(int i = 0; i < lines; ++i)
+		{
+			const RootMove& root_move = thread->root_moves[i];
+			int score = root_move.score;
+
+			bool mate = score > kMateInMaxPly || score < -kMateInMaxPly;
+			if(score > kMateInMaxPly)
+				score = (evaluation::kMateScore - score + 1) / 2;
+			else if(score < -kMateInMaxPly)
+				score = -(evaluation::kMateScore + score) / 2;
+
+			if(search->info_callback)
+			{
+				SearchInfo info = {depth, i + 1, score, mate, nodes, nps, time, 
+					hashfull, root_move.pv.data(), (int)root_move.pv.size()};
+				search->info_callback(info);
+				continue;
+			}
+
+			std::ostringstream info;
+			info << "info depth " << depth << " multipv " << i + 1 
+				<< " score " << (mate?"mate ":"cp ") << score
+				<< " nodes " << nodes << " nps " << nps << " time " << time
+				<< " hashfull " << hashfull << " pv";
+
+			for(const Move& move : root_move.pv)
+				info << " " << move_to_uci(move);
+
+			// Sent once per iteration so the GUI sees the progress.
+			output::send(info.str());
+		}
+	}
+
+	void init_root_moves(SearchThread *thread)
+	{
+		std::vector<Move> legal_moves;
+		if(thread->board.SideToMove() == WHITE)
+			move_generation::LegalAll<WHITE>(thread->board,&legal_moves);
+		else
+			move_generation::LegalAll<BLACK>(thread->board,&legal_moves);
+
+		thread->root_moves.clear();
+		for(const Move& move : legal_moves)
+			thread->root_moves.push_back({move,-kInfinite,{}});
+
+		thread->pv_index = 0;
+	}
+
+	// True for the root moves of the lines already searched
+	// in this iteration.
+	bool excluded_root_move(const SearchThread *thread, const Move& move)
+	{
+		for(int i = 0; i < thread->pv_index; ++i)
+		{
+			if(same_move(thread->root_moves[i].move,move))
+				return true;
+		}
+
+		return false;
+	}
+
+	// Stores the result of the search of the line pv_index and moves
+	// its root move in place. The sort is stable, so the moves of the
+	// later lines keep their order from the previous iteration.
+	void update_root_moves(SearchThread *thread, int score)
+	{
+		std::vector<RootMove>& root_moves = thread->root_moves;
+
+		for(size_t i = thread->pv_index; i < root_moves.size(); ++i)
+		{
+			RootMove& root_move = root_moves[i];
+			if(!same_move(root_move.move,thread->pv[0][0]))
+			{
+				root_move.score = -kInfinite;
+				continue;
+			}
+
+			root_move.score = score;
+			root_move.pv.assign(thread->pv[0],thread->pv[0] + thread->pv_length[0]);
+		}
+
+		std::stable_sort(root_moves.begin() + thread->pv_index,root_moves.end(),
+			[](const RootMove& a, const RootMove& b){return a.score > b.score;});
+	}
+}
 
 void TerminateSearch(Search *search, bool terminate)
 {
-	search->search_guard.lock();
-    search->stop = terminate; 
-	search->search_guard.unlock();
+	search->stop.store(terminate,std::memory_order_relaxed);
+
+	// Wake up the main thread if it's waiting for
+	// the stop command in an infinite search.
+	if(terminate)
+	{
+		std::lock_guard<std::mutex> lock(search->wake_mutex);
+		search->wake_condition.notify_all();
+	}
 }
 
-bool StartSearch(Search *search, Board *board)
+void PonderHit(Search *search)
 {
-	std::cout<<"Search started\n";
-    TerminateSearch(search, false);
+	// The time limit of a search that isn't pondering is read
+	// by the main search thread and has to stay as it is.
+	if(!search->ponder.load(std::memory_order_acquire))
+		return;
+
+	if(search->duration > 0)
+		search->duration += elapsed_ms(search);
+
+	search->ponder.store(false,std::memory_order_release);
+
+	// Wake up the main thread if the search is done
+	// and it's waiting to report the best move.
+	std::lock_guard<std::mutex> lock(search->wake_mutex);
+	search->wake_condition.notify_all();
+}
+
+bool SearchStopped(const Search *search)
+{
+	return search->stop.load(std::memory_order_relaxed);
+}
+
+u64 NodesSearched(const Search *search)
+{
+	u64 nodes = 0;
+	for(auto& thread : search->threads)
+		nodes += thread->nodes.load(std::memory_order_relaxed);
+
+	return nodes;
+}
+
+namespace
+{
+	void start_thread(SearchThread *thread)
+	{
+		std::lock_guard<std::mutex> lock(thread->mutex);
+		thread->searching = true;
+		thread->condition.notify_all();
+	}
+
+	void wait_for_thread(SearchThread *thread)
+	{
+		std::unique_lock<std::mutex> lock(thread->mutex);
+		thread->condition.wait(lock,[thread]{return !thread->searching;});
+	}
 
+	// Run by the main thread. Starts the helpers, searches
+	// and reports the best move once all threads are done.
+	void main_thread_search(Search *search)
+	{
+		SearchThread *main_thread = search->threads[0].get();
+
+		for(size_t i = 1; i < search->threads.size(); ++i)
+			start_thread(search->threads[i].get());
+
+		IterativeDeepening(search,main_thread);
+
+		// In an infinite search or while pondering the best move
+		// isn't reported before the stop command or the ponder hit,
+		// even if the search is done.
+		if(search->infinite || search->ponder)
+		{
+			std::unique_lock<std::mutex> lock(search->wake_mutex);
+			search->wake_condition.wait(lock,[search]{
+				return SearchStopped(search) || (!search->infinite && !search->ponder);
+			});
+		}
+
+		// The helpers run until the main thread is done.
+		TerminateSearch(search,true);
+		for(size_t i = 1; i < search->threads.size(); ++i)
+			wait_for_thread(search->threads[i].get());
+
+		SearchThread *best = best_thread(search);
+		search->best_move = best->root_best_move;
+		search->best_eval = best->best_score;
+
+		// Stopped before the first iteration was done or there
+		// is no legal move. Any legal move is better than no move
+		// and the static evaluation is better than no score.
+		if(search->best_move.from == SQUARE_NONE)
+		{
+			const Board& board = main_thread->board;
+			Side side = board.SideToMove();
+
+			std::vector<Move> legal_moves;
+			if(side == WHITE)
+				move_generation::LegalAll<WHITE>(board,&legal_moves);
+			else
+				move_generation::LegalAll<BLACK>(board,&legal_moves);
+
+			if(!legal_moves.empty())
+			{
+				search->best_move = legal_moves[0];
+				search->best_eval = board.Evaluate();
+			}
+			else
+				search->best_eval = board.InCheck(side)?-evaluation::kMateScore:evaluation::kDrawScore;
+		}
+
+		if(best != main_thread)
+			print_info(search,best,best->completed_depth,1);
+
+		if(!search->silent)
+		{
+			// The expected reply is the move to ponder on.
+			std::string bestmove = "bestmove " + move_to_uci(search->best_move);
+			if(best->completed_depth > 0 && best->root_moves[0].pv.size() >= 2
+				&& same_move(best->root_moves[0].pv[0],search->best_move))
+				bestmove += " ponder " + move_to_uci(best->root_moves[0].pv[1]);
+
+			output::send(bestmove);
+		}
+	}
+
+	// The OS threads of the pool sleep here between searches.
+	void idle_loop(Search *search, SearchThread *thread)
+	{
+		for(;;)
+		{
+			std::unique_lock<std::mutex> lock(thread->mutex);
+			thread->condition.wait(lock,[thread]{return thread->searching || thread->exit;});
+
+			if(thread->exit)
+				return;
+
+			lock.unlock();
+
+			if(thread->id == 0)
+				main_thread_search(search);
+			else
+				IterativeDeepening(search,thread);
+
+			lock.lock();
+			thread->searching = false;
+			thread->condition.notify_all();
+		}
+	}
+}
+
+Search::Search()
+{
+	best_move = NULL_MOVE;
+	best_eval = evaluation::kDrawScore;
+	depth = 0;
+	nodes = 0;
+	duration = 0;
+	opening_book = false;
+	infinite = false;
+	ponder = false;
+	multi_pv = 1;
+	silent = false;
+	move_overhead = kDefaultMoveOverhead;
+	stop = false;
+
+	SetThreadCount(this,1);
+}
+
+Search::~Search()
+{
+	TerminateSearch(this,true);
+	SetThreadCount(this,0);
+}
+
+void SetThreadCount(Search *search, int num_threads)
+{
+	WaitForSearchFinished(search);
+
+	for(auto& thread : search->threads)
+	{
+		{
+			std::lock_guard<std::mutex> lock(thread->mutex);
+			thread->exit = true;
+			thread->condition.notify_all();
+		}
+		thread->native_thread.join();
+	}
+
+	search->threads.clear();
+
+	for(int i = 0; i < num_threads; ++i)
+	{
+		SearchThread *thread = new SearchThread;
+		thread->id = i;
+		thread->heuristics.Clear();
+		thread->nodes = 0;
+		thread->searching = false;
+		thread->exit = false;
+
+		search->threads.emplace_back(thread);
+		thread->native_thread = std::thread(idle_loop,search,thread);
+	}
+}
+
+void WaitForSearchFinished(Search *search)
+{
+	if(!search->threads.empty())
+		wait_for_thread(search->threads[0].get());
+}
+
+void ClearEvaluationCaches(Search *search)
+{
+	WaitForSearchFinished(search);
+
+	for(auto& thread : search->threads)
+		thread->eval_cache.Clear();
+}
+
+void StartSearch(Search *search, const Board& board)
+{
+	WaitForSearchFinished(search);
+
+	search->stop = false;
+	search->start_time = std::chrono::steady_clock::now();
 	search->best_move = NULL_MOVE;
 	search->best_eval = evaluation::kDrawScore;
+	search->transposition_table.NewSearch();
 
-	AlphaBeta(search,board,std::numeric_limits<int>::min(),std::numeric_limits<int>::max(),search->depth,true);
+	init_reductions(search);
 
-	std::cout<<"Search stopped\n";
+	// The threads are sleeping so their data 
+	// can be set up from this thread.
+	for(auto& thread : search->threads)
+	{
+		thread->board = board;
+		thread->board.SetNetwork(search->network);
+		thread->nodes = 0;
+		thread->stopped = false;
+		thread->root_best_move = NULL_MOVE;
+		thread->best_score = -kInfinite;
+		thread->completed_depth = 0;
+		thread->heuristics.Age();
+	}
 
-	std::cout<<"Best move: "<<move_to_algebraic(search->best_move)<<"\n<<" << std::flush;
-	return true;
+	start_thread(search->threads[0].get());
 }
 
-// A naive alpha beta search just to have something that works. 
-int AlphaBeta(Search *search, Board *board, int alpha, int beta, int depth, bool maximizing_side)
+void IterativeDeepening(Search *search, SearchThread *thread)
 {
-	std::vector<Move> moves; 
+	int max_depth = (search->depth > 0)?std::min(search->depth,kMaxPly - 1):kMaxPly - 1;
 
-    if(board->SideToMove() == WHITE)
-	    move_generation::LegalAll<WHITE>(*board,&moves);
-    else
-	    move_generation::LegalAll<BLACK>(*board,&moves);
+	init_root_moves(thread);
 
-	if(depth == 0 || moves.size() == 0)	
-		return evaluation::evaluate(board);
+	// The helpers only search the best line. The lines share the
+	// transposition table and the move ordering tables, so the later 
+	// lines are much cheaper than separate searches.
+	int lines = (thread->id == 0)?std::min(search->multi_pv,(int)thread->root_moves.size()):1;
 
-	if(maximizing_side)
+	for(int depth = 1; depth <= max_depth; ++depth)
 	{
-		int value = std::numeric_limits<int>::max();
-		for(int i=0;i<moves.size();++i)
+		if(skip_depth(thread,depth))
+			continue;
+
+		int lines_done = 0;
+		for(thread->pv_index = 0; thread->pv_index < lines; ++thread->pv_index)
 		{
-			board->MakeMove(moves[i]);
-			value = std::max(value,AlphaBeta(search,board,alpha,beta,depth-1,false));
-			if(value > search->best_eval)
+			int score = AlphaBeta(search,thread,-kInfinite,kInfinite,depth,0);
+
+			// The result of an unfinished iteration can't be trusted
+			// unless nothing has been searched yet.
+			if(thread->stopped && thread->completed_depth > 0)
+				break;
+
+			if(thread->pv_length[0] > 0)
 			{
-				search->best_eval = value;
-				search->best_move = moves[i];
+				update_root_moves(thread,score);
+				++lines_done;
 			}
 
-			board->UndoMove();
+			if(thread->stopped)
+				break;
+		}
+
+		thread->pv_index = 0;
 
-			alpha = std::max(alpha,value);
+		if(lines_done > 0)
+		{
+			// A later line can end up with a better score than
+			// the ones before it. The best line is reported first.
+			std::stable_sort(thread->root_moves.begin(),thread->root_moves.begin() + lines_done,
+				[](const RootMove& a, const RootMove& b){return a.score > b.score;});
 
-			if(alpha >= beta) break;
+			thread->root_best_move = thread->root_moves[0].move;
+			thread->best_score = thread->root_moves[0].score;
+			thread->completed_depth = depth;
 
-			return value;
+			if(thread->id == 0)
+				print_info(search,thread,depth,lines_done);
 		}
+
+		if(thread->stopped || SearchStopped(search)) break;
 	}
-	else
+}
+
+int AlphaBeta(Search *search, SearchThread *thread, int alpha, int beta, int depth, int ply)
+{
+	thread->pv_length[ply] = ply;
+
+	if(depth <= 0)
+		return Quiescence(search,thread,alpha,beta,ply);
+
+	u64 nodes = count_node(thread);
+	if(ply > 0 && check_limits(search,thread,nodes))
+		return 0;
+
+	Board *board = &thread->board;
+
+	if(ply > 0 && board->IsDraw(ply))
+		return evaluation::kDrawScore;
+
+	if(ply >= kMaxPly)
+		return static_evaluation(thread);
+
+	const SearchParameters& params = search->params;
+	bool pv_node = (beta - alpha) > 1;
+	Side side = board->SideToMove();
+
+	u64 hash = board->state_.hash;
+	TTData tt_data;
+	bool tt_hit = search->transposition_table.Probe(hash,&tt_data);
+
+	// The root move of the line from the previous iteration comes first.
+	PackedMove hash_move = tt_hit?tt_data.best_move:kPackedMoveNone;
+	if(ply == 0 && thread->completed_depth > 0)
+		hash_move = pack_move(thread->root_moves[thread->pv_index].move);
+
+	if(!pv_node && tt_hit && tt_data.depth >= depth)
 	{
-		int value = std::numeric_limits<int>::min();		
-		for(int i=0;i<moves.size();++i)
+		int tt_score = score_from_tt(tt_data.evaluation,ply);
+
+		if(tt_data.type == TTENTRY_EXACT
+			|| (tt_data.type == TTENTRY_LOWER && tt_score >= beta)
+			|| (tt_data.type == TTENTRY_UPPER && tt_score <= alpha))
+			return tt_score;
+	}
+
+	bool in_check = board->InCheck(side);
+
+	SearchStack *ss = &thread->stack[ply];
+	ss->null_move = false;
+	ss->static_eval = in_check?-kInfinite:static_evaluation(thread);
+
+	// Reverse futility pruning. If the static evaluation is
+	// far enough above beta, assume that some move will hold it.
+	if(!pv_node 
+		&& !in_check 
+		&& depth <= params.rfp_max_depth
+		&& ss->static_eval - params.rfp_margin * depth >= beta
+		&& std::abs(beta) < kMateInMaxPly)
+	{
+		return ss->static_eval;
+	}
+
+	// Null move pruning. Give the opponent a free move and
+	// if the reduced search still fails high, the position
+	// is good enough to be cut. Not done without pieces 
+	// because of zugzwang, or after another null move.
+	bool previous_null = (ply >= 1) && thread->stack[ply-1].null_move;
+	if(!pv_node
+		&& !in_check
+		&& !previous_null
+		&& depth >= params.null_move_min_depth
+		&& ss->static_eval >= beta
+		&& board->HasNonPawnMaterial(side))
+	{
+		int reduction = params.null_move_reduction 
+			+ depth / params.null_move_depth_divisor
+			+ std::min((ss->static_eval - beta) / params.null_move_eval_divisor,3);
+
+		ss->null_move = true;
+		ss->current_move = NULL_MOVE;
+
+		board->MakeNullMove();
+		search->transposition_table.Prefetch(board->state_.hash);
+		int score = -AlphaBeta(search,thread,-beta,-beta + 1,depth - reduction - 1,ply + 1);
+		board->UndoNullMove();
+
+		ss->null_move = false;
+
+		if(thread->stopped)
+			return 0;
+
+		if(score >= beta)
+			return (score >= kMateInMaxPly)?beta:score;
+	}
+
+	OrderingContext context = ordering_context(thread,ply,hash_move);
+	ss->quiets_tried.clear();
+
+	// The hash move is searched before the moves are generated,
+	// so a cutoff by it saves the generation. It may come from
+	// another position with the same hash, which is why it's validated.
+	Move tt_move = board->UnpackMove(hash_move);
+	bool has_tt_move = hash_move != kPackedMoveNone && board->IsPseudoLegal(tt_move) && board->IsLegal(tt_move);
+	int tt_offset = has_tt_move?1:0;
+	bool generated = false;
+
+	CheckInfo check_info(*board);
+
+	bool improving = !in_check && ply >= 2 && ss->static_eval > thread->stack[ply-2].static_eval;
+	int futility_value = ss->static_eval + params.futility_margin_base + params.futility_margin * depth;
+	int lmp_limit = params.lmp_base + depth * depth / (improving?1:2);
+
+	int original_alpha = alpha;
+	int best_score = -kInfinite;
+	Move best_move = NULL_MOVE;
+	int legal_moves = 0;
+	bool skip_quiets = false;
+
+	for(int i = 0; ; ++i)
+	{
+		Move move = tt_move;
+		if(i >= tt_offset)
+		{
+			if(!generated)
+			{
+				generate_moves(*board,&ss->moves);
+				move_ordering::score_moves(thread->heuristics,context,ss->moves,&ss->scored_moves);
+				generated = true;
+			}
+
+			if(i - tt_offset >= (int)ss->scored_moves.size())
+				break;
+
+			move = move_ordering::pick_next_move(&ss->scored_moves,i - tt_offset);
+			if(has_tt_move && same_move(move,tt_move))
+				continue;
+		}
+
+		// The moves of the lines searched before are left out.
+		if(ply == 0 && excluded_root_move(thread,move))
+			continue;
+
+		bool quiet = !move.capture && move.type != PROMOTION;
+		bool gives_check = board->GivesCheck(move,check_info);
+
+		// Pruning of quiet moves. At least one legal move has to be
+		// searched first so that the node isn't mistaken for a mate.
+		// Checks are kept, they can change the evaluation a lot.
+		if(quiet && !in_check && !gives_check && legal_moves > 0 && best_score > -kMateInMaxPly)
 		{
-			board->MakeMove(moves[i]);
-			value = std::min(value,AlphaBeta(search,board,alpha,beta,depth-1,true));
+			if(skip_quiets)
+				continue;
 
-			board->UndoMove();
+			// Late move pruning.
+			if(!pv_node 
+				&& depth <= params.lmp_max_depth 
+				&& (int)ss->quiets_tried.size() >= lmp_limit)
+			{
+				skip_quiets = true;
+				continue;
+			}
 
-			beta = std::min(beta,value);
+			// Futility pruning.
+			if(depth <= params.futility_max_depth && futility_value <= alpha)
+			{
+				skip_quiets = true;
+				continue;
+			}
+		}
+
+		if(!board->IsLegal(move))
+			continue;
+
+		board->MakeMove(move);
+
+		// The child probes the table first, so the load of its
+		// bucket overlaps with the rest of the move's setup.
+		search->transposition_table.Prefetch(board->state_.hash);
 
-			if(alpha >= beta) break;
+		++legal_moves;
+		ss->current_move = move;
 
-			return value;
+		int new_depth = depth - 1;
+		int score;
+
+		if(legal_moves == 1)
+		{
+			score = -AlphaBeta(search,thread,-beta,-alpha,new_depth,ply + 1);
 		}
+		else
+		{
+			// Late move reductions. Quiet moves late in the
+			// move list are searched with a reduced depth.
+			int reduction = 0;
+			if(quiet 
+				&& !in_check 
+				&& !gives_check 
+				&& depth >= params.lmr_min_depth)
+			{
+				reduction = search->reductions[std::min(depth,kMaxPly - 1)][std::min(legal_moves,kMaxReductionMoves - 1)];
+				reduction -= move_ordering::quiet_history(thread->heuristics,context,move) / params.lmr_history_divisor;
+
+				if(pv_node) --reduction;
+				if(!improving) ++reduction;
+
+				reduction = std::max(0,std::min(reduction,new_depth - 1));
+			}
+
+			// Search the rest of the moves with a null window
+			// and re-search only if they turn out to be better.
+			score = -AlphaBeta(search,thread,-alpha - 1,-alpha,new_depth - reduction,ply + 1);
+
+			if(score > alpha && reduction > 0)
+				score = -AlphaBeta(search,thread,-alpha - 1,-alpha,new_depth,ply + 1);
+
+			if(score > alpha && score < beta)
+				score = -AlphaBeta(search,thread,-beta,-alpha,new_depth,ply + 1);
+		}
+
+		board->UndoMove();
+
+		if(thread->stopped)
+			return 0;
+
+		if(quiet)
+			ss->quiets_tried.push_back(move);
+
+		if(score > best_score)
+		{
+			best_score = score;
+
+			if(score > alpha)
+			{
+				alpha = score;
+				best_move = move;
+				update_pv(thread,ply,move);
+
+				if(alpha >= beta)
+				{
+					if(quiet)
+						move_ordering::update_quiet_stats(&thread->heuristics,context,ply,move,ss->quiets_tried,depth);
+					break;
+				}
+			}
+		}
+	}
+
+	if(legal_moves == 0)
+		return in_check?-evaluation::kMateScore + ply:evaluation::kDrawScore;
+
+	// The later MultiPV lines exclude the better root moves, so their
+	// result isn't the value of the root position.
+	if(ply == 0 && thread->pv_index > 0)
+		return best_score;
+
+	TTEntryType type = (best_score >= beta)?TTENTRY_LOWER
+		:(best_score > original_alpha)?TTENTRY_EXACT:TTENTRY_UPPER;
+	search->transposition_table.Store(hash,score_to_tt(best_score,ply),depth,type,pack_move(best_move));
+
+	return best_score;
+}
+
+int Quiescence(Search *search, SearchThread *thread, int alpha, int beta, int ply)
+{
+	thread->pv_length[ply] = ply;
+
+	u64 nodes = count_node(thread);
+	if(check_limits(search,thread,nodes))
+		return 0;
+
+	Board *board = &thread->board;
+
+	if(board->IsDraw(ply))
+		return evaluation::kDrawScore;
+
+	if(ply >= kMaxPly)
+		return static_evaluation(thread);
+
+	bool pv_node = (beta - alpha) > 1;
+	Side side = board->SideToMove();
+
+	u64 hash = board->state_.hash;
+	TTData tt_data;
+	bool tt_hit = search->transposition_table.Probe(hash,&tt_data);
+
+	if(!pv_node && tt_hit)
+	{
+		int tt_score = score_from_tt(tt_data.evaluation,ply);
+
+		if(tt_data.type == TTENTRY_EXACT
+			|| (tt_data.type == TTENTRY_LOWER && tt_score >= beta)
+			|| (tt_data.type == TTENTRY_UPPER && tt_score <= alpha))
+			return tt_score;
+	}
+
+	bool in_check = board->InCheck(side);
+
+	// When in check all the evasions are searched
+	// so the static evaluation can't be used as a bound.
+	int original_alpha = alpha;
+	int best_score = -kInfinite;
+	Move best_move = NULL_MOVE;
+	if(!in_check)
+	{
+		best_score = static_evaluation(thread);
+		if(best_score >= beta)
+			return best_score;
+
+		alpha = std::max(alpha,best_score);
+	}
+
+	SearchStack *ss = &thread->stack[ply];
+	generate_moves(*board,&ss->moves);
+
+	if(in_check)
+	{
+		PackedMove hash_move = tt_hit?tt_data.best_move:kPackedMoveNone;
+		OrderingContext context = ordering_context(thread,ply,hash_move);
+		move_ordering::score_moves(thread->heuristics,context,ss->moves,&ss->scored_moves);
 	}
+	else
+	{
+		move_ordering::score_captures(ss->moves,&ss->scored_moves);
+	}
+
+	int legal_moves = 0;
+
+	for(int i = 0; i < (int)ss->scored_moves.size(); ++i)
+	{
+		Move move = move_ordering::pick_next_move(&ss->scored_moves,i);
+
+		if(!board->IsLegal(move))
+			continue;
+
+		board->MakeMove(move);
+
+		++legal_moves;
+		ss->current_move = move;
+
+		int score = -Quiescence(search,thread,-beta,-alpha,ply + 1);
+
+		board->UndoMove();
+
+		if(thread->stopped)
+			return 0;
+
+		if(score > best_score)
+		{
+			best_score = score;
+
+			if(score > alpha)
+			{
+				alpha = score;
+				best_move = move;
+				update_pv(thread,ply,move);
+
+				if(alpha >= beta)
+					break;
+			}
+		}
+	}
+
+	if(in_check && legal_moves == 0)
+		return -evaluation::kMateScore + ply;
 
-    return 0;
+	TTEntryType type = (best_score >= beta)?TTENTRY_LOWER
+		:(best_score > original_alpha)?TTENTRY_EXACT:TTENTRY_UPPER;
+	search->transposition_table.Store(hash,score_to_tt(best_score,ply),0,type,pack_move(best_move));
+
+	return best_score;
 }
 
+int AllocateTime(const Search *search, int time_left, int increment, int moves_to_go)
+{
+	int available = time_left - search->move_overhead;
+	if(available <= 0)
+		return 1;
+
+	int moves = (moves_to_go > 0)?std::min(moves_to_go,kDefaultMovesToGo):kDefaultMovesToGo;
+	int time = available / moves + increment * 3 / 4;
 
+	// Never use more than half of the clock on a single move
+	// unless it's the last move before the time control.
+	int max_time = (moves_to_go == 1)?available * 9 / 10:available / 2;
+	time = std::min(time, max_time);
 
+	return std::max(time,1);
+}
+
+bool SetSearchParameter(SearchParameters *params, const std::string& name, const std::string& value)
+{
+	static const std::map<std::string, int SearchParameters::*> kIntParameters = 
+	{
+		{"null_move_min_depth", &SearchParameters::null_move_min_depth},
+		{"null_move_reduction", &SearchParameters::null_move_reduction},
+		{"null_move_depth_divisor", &SearchParameters::null_move_depth_divisor},
+		{"null_move_eval_divisor", &SearchParameters::null_move_eval_divisor},
+		{"lmr_min_depth", &SearchParameters::lmr_min_depth},
+		{"lmr_history_divisor", &SearchParameters::lmr_history_divisor},
+		{"rfp_max_depth", &SearchParameters::rfp_max_depth},
+		{"rfp_margin", &SearchParameters::rfp_margin},
+		{"futility_max_depth", &SearchParameters::futility_max_depth},
+		{"futility_margin_base", &SearchParameters::futility_margin_base},
+		{"futility_margin", &SearchParameters::futility_margin},
+		{"lmp_max_depth", &SearchParameters::lmp_max_depth},
+		{"lmp_base", &SearchParameters::lmp_base}
+	};
+
+	static const std::map<std::string, double SearchParameters::*> kDoubleParameters = 
+	{
+		{"lmr_base", &SearchParameters::lmr_base},
+		{"lmr_divisor", &SearchParameters::lmr_divisor}
+	};
+
+	try
+	{
+		auto int_parameter = kIntParameters.find(name);
+		if(int_parameter != kIntParameters.end())
+		{
+			params->*(int_parameter->second) = std::stoi(value);
+			return true;
+		}
+
+		auto double_parameter = kDoubleParameters.find(name);
+		if(double_parameter != kDoubleParameters.end())
+		{
+			params->*(double_parameter->second) = std::stod(value);
+			return true;
+		}
+	}
+	catch(const std::exception&)
+	{
+	}
+
+	return false;
+}
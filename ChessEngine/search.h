@@ -2,32 +2,276 @@
 #define SEARCH_H_
 
 #include "board.h"
+#include "move_ordering.h"
+#include "transposition.h"
+#include "pawns.h"
+#include "evaluate.h"
 
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <functional>
+
+// Information kept for each ply of the current search path.
+// The move lists are kept here so that they are allocated only
+// once and reused on every visit to the ply.
+struct SearchStack
+{
+    Move current_move;
+    int static_eval;
+
+    // True if the move made from this ply was a null move.
+    bool null_move;
+
+    std::vector<Move> moves;
+    std::vector<ScoredMove> scored_moves;
+    std::vector<Move> quiets_tried;
+};
+
+// A legal move at the root and the result of its last search.
+// The root moves are kept sorted by score so that the lines
+// are searched and reported best first.
+struct RootMove
+{
+    Move move;
+
+    // Below any real score if the move hasn't been 
+    // searched to the end in the current iteration.
+    int score;
+
+    std::vector<Move> pv;
+};
+
+// Data owned by a single search thread. The threads share
+// only the transposition table and the stop flag.
+struct SearchThread
+{
+    // Thread 0 is the main thread that reports the results.
+    int id;
+
+    Board board;
+    Heuristics heuristics;
+    PawnTable pawn_table;
+    MaterialTable material_table;
+    EvalCache eval_cache;
+    SearchStack stack[kMaxPly + 1];
+
+    // Triangular principal variation table.
+    Move pv[kMaxPly + 1][kMaxPly + 1];
+    int pv_length[kMaxPly + 1];
+
+    // Best move and score of the last completed iteration.
+    // The best move is searched first at the root.
+    Move root_best_move;
+    int best_score;
+    int completed_depth;
+
+    // In MultiPV mode a line is searched for each of the first
+    // multi_pv root moves. The moves of the lines before 
+    // pv_index are skipped at the root.
+    std::vector<RootMove> root_moves;
+    int pv_index;
+
+    // Read by the main thread to report the total node count.
+    std::atomic<u64> nodes;
+
+    // Set when the thread notices that the search has been stopped.
+    bool stopped;
+
+    // The OS thread sleeps on the condition variable
+    // until searching or exit is set.
+    std::thread native_thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool searching;
+    bool exit;
+};
+
+// Tunable parameters of the selective search.
+struct SearchParameters
+{
+    // Null move pruning. The reduction grows with depth
+    // and with how far the static evaluation is above beta.
+    int null_move_min_depth = 3;
+    int null_move_reduction = 3;
+    int null_move_depth_divisor = 6;
+    int null_move_eval_divisor = 200;
+
+    // Late move reductions: base + log(depth) * log(move number) / divisor.
+    // The reduction is adjusted by the history score of the move.
+    double lmr_base = 0.75;
+    double lmr_divisor = 2.25;
+    int lmr_min_depth = 3;
+    int lmr_history_divisor = 8192;
+
+    // Reverse futility pruning.
+    int rfp_max_depth = 8;
+    int rfp_margin = 80;
+
+    // Futility pruning of quiet moves.
+    int futility_max_depth = 6;
+    int futility_margin_base = 100;
+    int futility_margin = 100;
+
+    // Late move pruning. Quiet moves are skipped after
+    // lmp_base + depth * depth quiet moves have been tried.
+    int lmp_max_depth = 8;
+    int lmp_base = 3;
+};
+
+// Sets the parameter with the given name, for example "rfp_margin".
+// Returns false if there's no such parameter or the value isn't a number.
+bool SetSearchParameter(SearchParameters *params, const std::string& name, const std::string& value);
+
+const int kMaxReductionMoves = 64;
+
+const int kMaxThreads = 256;
+const int kMaxMultiPV = 256;
+const int kDefaultMoveOverhead = 10;
+
+// Progress of the search after a completed iteration.
+// Reported for each line in MultiPV mode.
+struct SearchInfo
+{
+    int depth;
+    int multipv;    // 1 for the best line.
+
+    // From the side to move's point of view. Mate scores are
+    // reported as a number of moves in mate instead.
+    int score;
+    bool mate;
+
+    u64 nodes;
+    u64 nps;
+    int time;       // in milliseconds.
+    int hashfull;   // per mille.
+
+    const Move *pv;
+    int pv_length;
+};
 
 struct Search
 {
-    Move best_move; 
+    Move best_move;
 	int best_eval; // current best evaluation value.
-    int depth;      
-    int nodes;
-    int duration;   //in milliseconds
-    bool stop;
+    int depth;      // 0 for no depth limit.
+    u64 nodes;      // 0 for no node limit.
+    int duration;   // in milliseconds, 0 for infinite.
     bool opening_book;
 
-	// This should be locked when accessing 
-	// members of the struct when the search 
-	// thread is active.
-	std::mutex search_guard;
+    // Set by "go infinite". The best move isn't reported before
+    // the search is stopped. A "go" without limits also searches
+    // until it's stopped but reports the best move when the
+    // maximum depth is reached.
+    bool infinite;
+
+    // Set while searching on the opponent's time after "go ponder".
+    // The time and node limits apply only after PonderHit and the
+    // best move isn't reported before the ponder hit or the stop.
+    std::atomic<bool> ponder;
+
+    // Number of principal variations to report.
+    int multi_pv;
+
+    // Set when the search is used internally, for example by
+    // the training data generator. Nothing is printed.
+    bool silent;
+
+    // Called by the main search thread for each line after each
+    // iteration when set. The info lines aren't printed then.
+    std::function<void(const SearchInfo&)> info_callback;
+
+    // Time in milliseconds reserved for the communication 
+    // with the GUI. Subtracted from the clock time.
+    int move_overhead;
+
+    // Polled by the search threads with relaxed loads.
+    std::atomic<bool> stop;
+
+    // The main search thread waits here for the stop or the ponder
+    // hit when it's done early. Unlike the mutexes of the threads
+    // these live as long as the search, so the stop can be sent 
+    // from another thread while the pool is resized.
+    std::mutex wake_mutex;
+    std::condition_variable wake_condition;
+
+    std::chrono::steady_clock::time_point start_time;
+
+    SearchParameters params;
+
+    // Late move reductions indexed by [depth][move number].
+    // Calculated from params when the search starts.
+    int reductions[kMaxPly][kMaxReductionMoves];
+
+    // Shared by all the search threads.
+    TranspositionTable transposition_table;
+
+    // Network of the NNUE evaluation, nullptr for the classical
+    // evaluation. Copied to the boards of the threads when the
+    // search starts, so it can be replaced between searches.
+    std::shared_ptr<const nnue::Network> network;
+
+    // Persistent thread pool. The threads are created by
+    // SetThreadCount and reused so that the move ordering
+    // tables carry over between moves.
+    std::vector<std::unique_ptr<SearchThread>> threads;
+
+    Search();
+    ~Search();
 };
 
-// This function will be running in a separate thread.
-bool StartSearch(Search *search, Board *board);
+// Resizes the thread pool. Waits for the current search to finish.
+void SetThreadCount(Search *search, int num_threads);
+
+// Clears the evaluation caches of the threads.
+// Called when the evaluation function changes.
+void ClearEvaluationCaches(Search *search);
+
+// Starts the search on the pool threads (Lazy SMP) and returns 
+// immediately. The board is copied to the threads so the caller 
+// is free to modify it during the search. The main search thread 
+// prints the best move when the search is done.
+void StartSearch(Search *search, const Board& board);
 
-int AlphaBeta(Search *search, Board *board, int alpha, int beta, int depth, bool maximizing_side);
+// Blocks until the current search has finished 
+// and the best move has been printed.
+void WaitForSearchFinished(Search *search);
 
-// Terminates the search thread.
+// Iterative deepening loop run by every search thread.
+void IterativeDeepening(Search *search, SearchThread *thread);
+
+// Principal variation search. Returns the score of the position
+// from the side to move's point of view.
+int AlphaBeta(Search *search, SearchThread *thread, int alpha, int beta, int depth, int ply);
+
+// Searches captures until the position is quiet so that
+// the evaluation isn't done in the middle of an exchange.
+int Quiescence(Search *search, SearchThread *thread, int alpha, int beta, int ply);
+
+// Tells the search threads to stop. Only touches the stop flag
+// and the wake condition, so it can be called from any thread.
 void TerminateSearch(Search *search, bool terminate);
 
+// Called when the opponent played the move that was pondered on.
+// The search goes on with its limits. The time limit counts
+// from the ponder hit, so the time spent pondering is a bonus.
+void PonderHit(Search *search);
+
+// Returns true if the search has been told to stop.
+bool SearchStopped(const Search *search);
+
+// Returns the number of nodes searched by all the threads.
+u64 NodesSearched(const Search *search);
+
+// Returns the time in milliseconds to spend on the next move
+// when the side to move has time_left on the clock and gets
+// increment after the move. moves_to_go is 0 if the rest of the
+// game has to be played in the remaining time.
+int AllocateTime(const Search *search, int time_left, int increment, int moves_to_go);
+
 #endif
@@ -10,6 +10,7 @@
 #include "move_generation.h"
 #include "util.h"
 #include "bitboards.h"
+#include "fen.h"
 
 namespace
 {
@@ -58,6 +59,381 @@ namespace
 		}
 	}
 
+	// Counts the checks of the board tests and prints the failed ones.
+	struct TestCounter
+	{
+		unsigned passed = 0;
+		unsigned total = 0;
+
+		void Check(bool ok, const std::string& description)
+		{
+			++total;
+			if (ok) ++passed;
+			else std::cout << "FAILED: " << description << "\n";
+		}
+	};
+
+	// Returns true if the move in UCI notation is legal in the position.
+	bool is_legal_move(const std::string& fen, const std::string& uci_move)
+	{
+		Board board;
+		if (!board.SetPositionFromFEN(fen)) return false;
+
+		Move move = move_from_uci(board, uci_move);
+		return move.type != MOVE_TYPE_NONE && board.IsPseudoLegal(move) && board.IsLegal(move);
+	}
+
+	void check_legal(TestCounter *counter, const std::string& fen, const std::string& uci_move, bool expected)
+	{
+		counter->Check(is_legal_move(fen, uci_move) == expected,
+			fen + " " + uci_move + (expected ? " should be legal" : " should be illegal"));
+	}
+
+	// Every square pair and promotion that passes IsPseudoLegal and 
+	// IsLegal has to be a generated move and the other way around.
+	bool legality_matches_generator(const Board& board)
+	{
+		std::vector<Move> generated;
+		if (board.SideToMove() == WHITE)
+			move_generation::LegalAll<WHITE>(board, &generated);
+		else
+			move_generation::LegalAll<BLACK>(board, &generated);
+
+		const PieceType promotions[] = {PIECE_TYPE_NONE, WHITE_KNIGHTS, WHITE_BISHOPS, WHITE_ROOKS, WHITE_QUEEN,
+			BLACK_KNIGHTS, BLACK_BISHOPS, BLACK_ROOKS, BLACK_QUEEN};
+
+		size_t accepted = 0;
+		for (int from = A8; from < NUM_SQUARES; ++from)
+		{
+			for (int to = A8; to < NUM_SQUARES; ++to)
+			{
+				for (PieceType promotion : promotions)
+				{
+					Move move = board.MoveFromSquares((Square)from, (Square)to, promotion);
+					if (!board.IsPseudoLegal(move) || !board.IsLegal(move)) continue;
+
+					++accepted;
+					bool found = std::any_of(generated.begin(), generated.end(),
+						[&move](const Move& m) { return same_move(m, move); });
+					if (!found) return false;
+				}
+			}
+		}
+
+		return accepted == generated.size();
+	}
+
+	void test_move_legality(TestCounter *counter)
+	{
+		// Pinned pieces may only move along the pin.
+		check_legal(counter, "4k3/4r3/8/8/8/8/4B3/4K3 w - - 0 1", "e2d3", false);
+		check_legal(counter, "4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1", "e2d2", false);
+		check_legal(counter, "4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1", "e2e5", true);
+		check_legal(counter, "4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1", "e2e7", true);
+		check_legal(counter, "4k3/8/8/b7/8/8/3N4/4K3 w - - 0 1", "d2f3", false);
+		check_legal(counter, "4k3/8/8/b7/8/8/3N4/4K3 w - - 0 1", "e1f1", true);
+		check_legal(counter, "4k3/8/8/8/8/8/4p3/2B1K3 b - - 0 1", "e2e1q", false);
+
+		// Evasions: capture the checker, block or move the king off the line.
+		check_legal(counter, "4k3/8/8/8/8/1N6/8/r3K3 w - - 0 1", "b3a1", true);
+		check_legal(counter, "4k3/8/8/8/8/1N6/8/r3K3 w - - 0 1", "b3c1", true);
+		check_legal(counter, "4k3/8/8/8/8/1N6/8/r3K3 w - - 0 1", "b3d2", false);
+		check_legal(counter, "4k3/8/8/8/8/1N6/8/r3K3 w - - 0 1", "e1f1", false);
+		check_legal(counter, "4k3/8/8/8/8/1N6/8/r3K3 w - - 0 1", "e1e2", true);
+
+		// Double check, only the king can move.
+		check_legal(counter, "4k3/8/8/8/8/5n2/1R6/r3K3 w - - 0 1", "b2b1", false);
+		check_legal(counter, "4k3/8/8/8/8/5n2/1R6/r3K3 w - - 0 1", "e1d2", false);
+		check_legal(counter, "4k3/8/8/8/8/5n2/1R6/r3K3 w - - 0 1", "e1e2", true);
+
+		// Castling.
+		check_legal(counter, "4k3/8/8/8/8/8/8/4K2R w K - 0 1", "e1g1", true);
+		check_legal(counter, "4kr2/8/8/8/8/8/8/4K2R w K - 0 1", "e1g1", false);
+		check_legal(counter, "4k1r1/8/8/8/8/8/8/4K2R w K - 0 1", "e1g1", false);
+		check_legal(counter, "4r1k1/8/8/8/8/8/8/4K2R w K - 0 1", "e1g1", false);
+		check_legal(counter, "4k3/8/8/8/8/8/8/4K1NR w K - 0 1", "e1g1", false);
+		check_legal(counter, "4k3/8/8/8/8/8/8/4K2R w - - 0 1", "e1g1", false);
+		check_legal(counter, "1r2k3/8/8/8/8/8/8/R3K3 w Q - 0 1", "e1c1", true);
+		check_legal(counter, "3rk3/8/8/8/8/8/8/R3K3 w Q - 0 1", "e1c1", false);
+		check_legal(counter, "r3k3/8/8/8/8/8/8/4K2R b q - 0 1", "e8c8", true);
+		check_legal(counter, "r3k3/8/8/8/8/8/8/4K2R b q - 0 1", "e8c8q", false);
+
+		// Promotions.
+		check_legal(counter, "4k3/P7/8/8/8/8/8/4K3 w - - 0 1", "a7a8q", true);
+		check_legal(counter, "4k3/P7/8/8/8/8/8/4K3 w - - 0 1", "a7a8n", true);
+		check_legal(counter, "4k3/P7/8/8/8/8/8/4K3 w - - 0 1", "a7a8", false);
+		check_legal(counter, "4k3/P7/8/8/8/8/8/4K3 w - - 0 1", "e1e2q", false);
+		check_legal(counter, "1r2k3/P7/8/8/8/8/8/4K3 w - - 0 1", "a7b8r", true);
+		check_legal(counter, "n3k3/P7/8/8/8/8/8/4K3 w - - 0 1", "a7a8q", false);
+		check_legal(counter, "4k3/8/8/8/8/8/p7/4K3 b - - 0 1", "a2a1b", true);
+
+		// Moves stored in the search tables come from other positions.
+		Board board;
+		board.SetPositionFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		Move e2e4 = move_from_uci(board, "e2e4");
+		Move g1f3 = move_from_uci(board, "g1f3");
+
+		counter->Check(board.IsPseudoLegal(board.UnpackMove(pack_move(e2e4))), "hash move e2e4 in the start position");
+
+		board.MakeMove(e2e4);
+		counter->Check(!board.IsPseudoLegal(board.UnpackMove(pack_move(e2e4))), "stale hash move e2e4 after it was played");
+		counter->Check(!board.IsPseudoLegal(g1f3), "move of the side that isn't to move");
+		counter->Check(!board.IsPseudoLegal(board.UnpackMove(kPackedMoveNone)), "empty hash move");
+
+		// The fields of a killer have to match the pieces on the board.
+		board.SetPositionFromFEN("4k3/8/8/8/8/5n2/8/4KN2 w - - 0 1");
+		Move killer = board.MoveFromSquares(F1, D2, PIECE_TYPE_NONE);
+		board.SetPositionFromFEN("4k3/8/8/8/8/5n2/8/4KB2 w - - 0 1");
+		counter->Check(!board.IsPseudoLegal(killer), "killer knight move with a bishop on the square");
+
+		board.SetPositionFromFEN("4k3/8/8/8/8/5n2/4P3/4K3 w - - 0 1");
+		Move capture = move_from_uci(board, "e2f3");
+		board.SetPositionFromFEN("4k3/8/8/8/8/5b2/4P3/4K3 w - - 0 1");
+		counter->Check(!board.IsPseudoLegal(capture), "capture of a knight with a bishop on the square");
+
+		board.SetPositionFromFEN("4k3/P7/8/8/8/8/8/4K3 w - - 0 1");
+		PackedMove white_promotion = pack_move(move_from_uci(board, "a7a8q"));
+		board.SetPositionFromFEN("4k3/8/8/8/8/8/p7/4K3 b - - 0 1");
+		counter->Check(!board.IsPseudoLegal(board.UnpackMove((PackedMove)(white_promotion ^ (A8 ^ A1) ^ ((A7 ^ A2) << 6)))),
+			"promotion to a piece of the other side");
+
+		// The functions have to agree with the move generator,
+		// whose move counts are checked by perft.
+		for (auto result : tests::PerftTestPositions)
+		{
+			board.SetPositionFromFEN(result.second.fen);
+			counter->Check(legality_matches_generator(board), "legal moves of " + result.second.fen);
+		}
+	}
+
+	void check_gives_check(TestCounter *counter, const std::string& fen, const std::string& uci_move, bool expected)
+	{
+		Board board;
+		board.SetPositionFromFEN(fen);
+		Move move = move_from_uci(board, uci_move);
+
+		bool ok = move.type != MOVE_TYPE_NONE && board.GivesCheck(move, CheckInfo(board)) == expected;
+		counter->Check(ok, fen + " " + uci_move + (expected ? " should give check" : " shouldn't give check"));
+	}
+
+	// GivesCheck has to agree with making every legal move.
+	bool gives_check_matches_make_move(Board board)
+	{
+		std::vector<Move> moves;
+		if (board.SideToMove() == WHITE)
+			move_generation::LegalAll<WHITE>(board, &moves);
+		else
+			move_generation::LegalAll<BLACK>(board, &moves);
+
+		CheckInfo info(board);
+		Side opponent = get_opposing_side(board.SideToMove());
+
+		for (const Move& move : moves)
+		{
+			bool expected = board.GivesCheck(move, info);
+			board.MakeMove(move);
+			bool in_check = board.InCheck(opponent);
+			board.UndoMove();
+
+			if (expected != in_check) return false;
+		}
+
+		return true;
+	}
+
+	void test_gives_check(TestCounter *counter)
+	{
+		// Direct checks.
+		check_gives_check(counter, "4k3/8/8/8/8/8/8/4K1N1 w - - 0 1", "g1f3", false);
+		check_gives_check(counter, "4k3/8/8/8/8/8/3N4/4K3 w - - 0 1", "d2f3", false);
+		check_gives_check(counter, "4k3/8/8/6N1/8/8/8/4K3 w - - 0 1", "g5f7", false);
+		check_gives_check(counter, "4k3/8/8/8/6N1/8/8/4K3 w - - 0 1", "g4f6", true);
+		check_gives_check(counter, "4k3/8/3P4/8/8/8/8/4K3 w - - 0 1", "d6d7", true);
+		check_gives_check(counter, "4k3/8/8/8/8/8/8/R3K3 w - - 0 1", "a1a8", true);
+		check_gives_check(counter, "4k3/8/8/8/8/8/8/B3K3 w - - 0 1", "a1b2", false);
+		check_gives_check(counter, "4k3/8/8/8/8/8/8/Q3K3 w - - 0 1", "a1a4", true);
+		check_gives_check(counter, "4k3/8/8/8/8/8/8/Q3K3 w - - 0 1", "a1b1", false);
+		check_gives_check(counter, "4k3/8/8/1r6/2B5/8/8/Q3K3 w - - 0 1", "c4b5", true);
+
+		// A slider's check can be blocked by the own pieces.
+		check_gives_check(counter, "4k3/4p3/8/8/8/8/8/R5K1 w - - 0 1", "a1e1", false);
+		check_gives_check(counter, "4k3/8/8/8/8/8/4P3/R3K3 w - - 0 1", "a1a8", true);
+
+		// Discovered checks, also when the moved piece captures.
+		check_gives_check(counter, "4k3/8/8/8/4N3/8/8/4RK2 w - - 0 1", "e4c5", true);
+		check_gives_check(counter, "4k3/8/8/8/4N3/8/8/4RK2 w - - 0 1", "e4c3", true);
+		check_gives_check(counter, "4k3/8/8/8/8/2B5/3p4/4K1B1 w - - 0 1", "c3d2", false);
+		check_gives_check(counter, "4k3/8/8/8/4P3/8/8/4RK2 w - - 0 1", "e4e5", false);
+		check_gives_check(counter, "4k3/8/8/3p4/4P3/8/8/4RK2 w - - 0 1", "e4d5", true);
+
+		// Promotions check from the promotion square.
+		check_gives_check(counter, "2k5/P7/8/8/8/8/8/4K3 w - - 0 1", "a7a8q", true);
+		check_gives_check(counter, "2k5/P7/8/8/8/8/8/4K3 w - - 0 1", "a7a8b", false);
+		check_gives_check(counter, "8/P2k4/8/8/8/8/8/4K3 w - - 0 1", "a7a8n", false);
+		check_gives_check(counter, "8/P1k5/8/8/8/8/8/4K3 w - - 0 1", "a7a8r", false);
+		check_gives_check(counter, "8/P7/1k6/8/8/8/8/4K3 w - - 0 1", "a7a8n", true);
+
+		// The rook gives check after castling.
+		check_gives_check(counter, "5k2/8/8/8/8/8/8/4K2R w K - 0 1", "e1g1", true);
+		check_gives_check(counter, "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", "e1c1", true);
+		check_gives_check(counter, "4k3/8/8/8/8/8/8/4K2R w K - 0 1", "e1g1", false);
+
+		Board board;
+		for (auto result : tests::PerftTestPositions)
+		{
+			board.SetPositionFromFEN(result.second.fen);
+			counter->Check(gives_check_matches_make_move(board), "checking moves of " + result.second.fen);
+		}
+	}
+
+	// Sets the position and plays the moves in UCI notation.
+	void set_position(Board *board, const std::string& fen, const std::vector<std::string>& moves)
+	{
+		board->SetPositionFromFEN(fen);
+		for (const std::string& uci_move : moves)
+			board->MakeMove(move_from_uci(*board, uci_move));
+	}
+
+	void check_draw(TestCounter *counter, const std::string& fen, const std::vector<std::string>& moves, int ply, bool expected)
+	{
+		Board board;
+		set_position(&board, fen, moves);
+
+		std::string description = fen;
+		for (const std::string& uci_move : moves)
+			description += " " + uci_move;
+
+		counter->Check(board.IsDraw(ply) == expected, description + " at ply " + std::to_string(ply)
+			+ (expected ? " should be a draw" : " shouldn't be a draw"));
+	}
+
+	void test_draws(TestCounter *counter)
+	{
+		const std::string start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+		const std::vector<std::string> knights = {"g1f3", "g8f6", "f3g1", "f6g8"};
+
+		// Before the root a position has to occur three times,
+		// after the root it's enough that it occurs twice.
+		check_draw(counter, start, {}, 0, false);
+		check_draw(counter, start, knights, 0, false);
+		check_draw(counter, start, knights, 4, true);
+		check_draw(counter, start, knights, 3, false);
+		check_draw(counter, start, {"g1f3", "g8f6", "f3g1", "f6g8", "g1f3", "g8f6", "f3g1", "f6g8"}, 0, true);
+		check_draw(counter, "4k3/8/8/8/8/8/8/R3K3 w - - 0 1", {"a1a2", "e8d8", "a2a1", "d8e8"}, 4, true);
+
+		// The same squares with the other side to move aren't a repetition.
+		check_draw(counter, "4k3/8/8/8/8/8/8/R3K3 w - - 0 1", {"a1a2", "e8d8", "a2a3", "d8e8", "a3a1"}, 5, false);
+
+		// A pawn move or a capture makes the earlier positions unreachable.
+		check_draw(counter, "4k3/4p3/8/8/8/8/8/R3K3 b - - 0 1", {"e8d8", "a1a2", "d8e8", "a2a1", "e7e6"}, 5, false);
+
+		// The fifty move rule, unless the hundredth ply mates.
+		check_draw(counter, "4k3/8/8/8/8/8/8/R3K3 w - - 99 80", {}, 0, false);
+		check_draw(counter, "4k3/8/8/8/8/8/8/R3K3 w - - 99 80", {"a1a2"}, 0, true);
+		check_draw(counter, "7k/8/6K1/8/8/8/8/R7 w - - 99 80", {"a1a8"}, 0, false);
+		check_draw(counter, "7k/8/8/8/8/8/8/R5K1 w - - 99 80", {"a1a8"}, 0, true);
+
+		// Insufficient material.
+		check_draw(counter, "4k3/8/8/8/8/8/8/4KN2 w - - 0 1", {}, 0, true);
+		check_draw(counter, "4k3/8/8/8/8/8/8/4KB2 b - - 0 1", {}, 0, true);
+		check_draw(counter, "4k3/8/8/8/8/8/8/4K3 w - - 0 1", {}, 0, true);
+		check_draw(counter, "4k3/8/8/8/8/8/8/3NKN2 w - - 0 1", {}, 0, false);
+		check_draw(counter, "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1", {}, 0, false);
+		check_draw(counter, "4k3/8/8/8/8/8/8/4KR2 w - - 0 1", {}, 0, false);
+	}
+
+	void check_fen_round_trip(TestCounter *counter, const std::string& fen)
+	{
+		Board board;
+		bool parsed = board.SetPositionFromFEN(fen);
+		counter->Check(parsed && board.GenerateFenString() == fen, fen + " should be written back unchanged");
+	}
+
+	void check_fen_rejected(TestCounter *counter, const std::string& fen)
+	{
+		Bitboard pieces[NUM_PIECE_TYPES];
+		State state;
+		counter->Check(!fen::parse(fen, pieces, &state), fen + " should be rejected");
+	}
+
+	void test_fen(TestCounter *counter)
+	{
+		check_fen_round_trip(counter, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		check_fen_round_trip(counter, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+		check_fen_round_trip(counter, "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2");
+		check_fen_round_trip(counter, "r3k3/8/8/8/3pP3/8/8/4K2R b Kq e3 12 40");
+
+		// The move counters are optional.
+		Board board;
+		counter->Check(board.SetPositionFromFEN("4k3/8/8/8/8/8/8/4K3 b - -")
+			&& board.GenerateFenString() == "4k3/8/8/8/8/8/8/4K3 b - - 0 1", "default move counters");
+
+		// A rejected string leaves the board unchanged.
+		board.SetPositionFromFEN("4k3/8/8/8/8/8/8/4K3 w - - 5 9");
+		counter->Check(!board.SetPositionFromFEN("4k3/8/8/8/8/8/8/4K3 w - - 5 9 junk")
+			&& board.GenerateFenString() == "4k3/8/8/8/8/8/8/4K3 w - - 5 9", "board unchanged after an error");
+
+		// Ranks of the wrong length or count.
+		check_fen_rejected(counter, "rnbqkbnr/ppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		check_fen_rejected(counter, "rnbqkbnr/ppppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		check_fen_rejected(counter, "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		check_fen_rejected(counter, "rnbqkbnr/pppppppp/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		check_fen_rejected(counter, "rnbqkbnr/pppppppp/8/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+		// Pieces.
+		check_fen_rejected(counter, "P3k3/8/8/8/8/8/8/4K3 w - - 0 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/p3K3 w - - 0 1");
+		check_fen_rejected(counter, "8/8/8/8/8/8/8/4K3 w - - 0 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/3KK3 w - - 0 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K2X w - - 0 1");
+
+		// Side to move and castling rights without the king or the rook.
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K3 x - - 0 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K3 w K - 0 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/3K3R w K - 0 1");
+		check_fen_rejected(counter, "r3k3/8/8/8/8/8/8/4K3 w k - 0 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K2R w KK - 0 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K2R w KX - 0 1");
+
+		// En passant squares on the wrong rank or off the board.
+		check_fen_rejected(counter, "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e3 0 2");
+		check_fen_rejected(counter, "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e6 0 2");
+		check_fen_rejected(counter, "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq i6 0 2");
+
+		// Missing fields, bad counters and trailing junk.
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K3 w -");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K3 w - - x 1");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K3 w - - 0 1x");
+		check_fen_rejected(counter, "4k3/8/8/8/8/8/8/4K3 w - - 0 1 0");
+
+		// EPD operations.
+		Bitboard pieces[NUM_PIECE_TYPES];
+		State state;
+		std::string_view operations, operands;
+
+		bool parsed = fen::parse_epd("4k3/8/8/8/8/8/8/4K3 b - - hmvc 12; fmvn 34; id \"counters\";", pieces, &state, &operations);
+		counter->Check(parsed && state.half_moves == 12 && state.full_moves == 34, "EPD hmvc and fmvn");
+		counter->Check(fen::find_operation(operations, "id", &operands) && operands == "\"counters\"", "EPD id after the counters");
+
+		parsed = fen::parse_epd("4k3/8/8/8/8/8/8/4K3 w - -", pieces, &state, &operations);
+		counter->Check(parsed && state.half_moves == 0 && state.full_moves == 1 && operations.empty(), "EPD without operations");
+
+		counter->Check(!fen::parse_epd("4k3/8/8/8/8/8/8/4K3 w - - hmvc x;", pieces, &state, &operations), "EPD bad hmvc should be rejected");
+
+		// Semicolons and opcodes inside quotes belong to the operand.
+		std::string_view quoted = "c0 \"bm e4; ce 10\"; bm d4; id \"a;b\";";
+		counter->Check(fen::find_operation(quoted, "bm", &operands) && operands == "d4", "EPD opcode after a quoted semicolon");
+		counter->Check(!fen::find_operation(quoted, "ce", &operands), "EPD opcode inside quotes");
+		counter->Check(fen::find_operation(quoted, "id", &operands) && operands == "\"a;b\"", "EPD quoted semicolon in the operand");
+		counter->Check(fen::find_operation("noop; bm e4;", "noop", &operands) && operands.empty(), "EPD opcode without operands");
+
+		// The EPD output has only the position fields.
+		board.SetPositionFromFEN("r3k3/8/8/8/3pP3/8/8/4K2R b Kq e3 12 40");
+		char epd[fen::kMaxFenLength];
+		size_t length = fen::write(board, epd, true);
+		counter->Check(std::string(epd, length) == "r3k3/8/8/8/3pP3/8/8/4K2R b Kq e3", "EPD output");
+	}
+
 	int perft(Board board, int depth, int start_depth, PerftStats *stats)
 	{
 		std::vector<Move> move_list;
@@ -109,7 +485,7 @@ namespace tests
 
 	void init_perft(const std::string& perft_results_file)
 	{
-		std::cout << "Initializing tests...\n";
+		std::cerr << "Initializing tests...\n";
 		read_perft_results_file(perft_results_file);
 	}
 
@@ -216,6 +592,17 @@ namespace tests
         return results_match;
 	}
 
+	void start_board_tests()
+	{
+		TestCounter counter;
+		test_move_legality(&counter);
+		test_gives_check(&counter);
+		test_draws(&counter);
+		test_fen(&counter);
+
+		std::cout << counter.passed << " out of " << counter.total << " passed. \n";
+	}
+
 	void print_attacks(PieceType piece, Square square)
 	{
 		if (square == SQUARE_NONE) return;
@@ -77,4 +77,9 @@ namespace tests
 
     // Write result moves into result_str in lexicographical order.
     void write_moves_to_result_string(PerftStats& stats, std::ostringstream& result_str);
+
+	// Checks the board functions that perft can't catch, such as the
+	// validation of hash moves, on hand picked positions. Prints the
+	// failed checks and how many checks passed.
+	void start_board_tests();
 }
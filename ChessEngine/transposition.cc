@@ -1,14 +1,175 @@
 #include "transposition.h"
 
-const int kDefaultTTSize = 64;
+#include <climits>
+#include <cstdlib>
+#include <new>
 
-TranspositionTable::TranspositionTable(unsigned size_mb = kDefaultTTSize)
+namespace
+{
+	inline u64 pack_data(int evaluation, int depth, TTEntryType type, PackedMove best_move, u8 generation)
+	{
+		return (u64)best_move
+			| ((u64)(uint32_t)evaluation << 16)
+			| ((u64)(u8)depth << 48)
+			| ((u64)type << 56)
+			| ((u64)generation << 58);
+	}
+
+	inline TTData unpack_data(u64 data)
+	{
+		TTData result;
+		result.best_move = (PackedMove)(data & 0xFFFF);
+		result.evaluation = (int32_t)(uint32_t)((data >> 16) & 0xFFFFFFFF);
+		result.depth = (int8_t)((data >> 48) & 0xFF);
+		result.type = (TTEntryType)((data >> 56) & 0x3);
+		return result;
+	}
+
+	inline u8 entry_generation(u64 data)
+	{
+		return (u8)(data >> 58);
+	}
+
+	inline int entry_depth(u64 data)
+	{
+		return (int8_t)((data >> 48) & 0xFF);
+	}
+
+	const u8 kGenerationMask = 0x3F;
+}
+
+TranspositionTable::TranspositionTable(unsigned size_mb)
+	: buckets(nullptr), size_mb(0), num_buckets(0), generation(0)
 {
-	this->size_mb = size_mb;
 	SetSize(size_mb);
 }
 
+TranspositionTable::~TranspositionTable()
+{
+	delete[] buckets;
+}
+
 void TranspositionTable::SetSize(unsigned size_mb)
 {
+	if(size_mb == 0) size_mb = 1;
+
+	delete[] buckets;
+
+	this->size_mb = size_mb;
+	num_buckets = ((u64)size_mb * 1024 * 1024) / sizeof(TTBucket);
+	buckets = new TTBucket[num_buckets];
+
+	Clear();
 }
 
+void TranspositionTable::Clear()
+{
+	for(u64 i = 0; i < num_buckets; ++i)
+	{
+		for(int j = 0; j < kTTBucketSize; ++j)
+		{
+			buckets[i].entries[j].key.store(0, std::memory_order_relaxed);
+			buckets[i].entries[j].data.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	generation = 0;
+}
+
+void TranspositionTable::NewSearch()
+{
+	generation = (generation + 1) & kGenerationMask;
+}
+
+bool TranspositionTable::Probe(u64 hash, TTData *data) const
+{
+	const TTBucket& bucket = buckets[hash % num_buckets];
+
+	for(int i = 0; i < kTTBucketSize; ++i)
+	{
+		u64 entry_key = bucket.entries[i].key.load(std::memory_order_relaxed);
+		u64 entry_data = bucket.entries[i].data.load(std::memory_order_relaxed);
+
+		if((entry_key ^ entry_data) == hash && entry_data != 0)
+		{
+			*data = unpack_data(entry_data);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TranspositionTable::Store(u64 hash, int evaluation, int depth, TTEntryType type, PackedMove best_move)
+{
+	TTBucket& bucket = buckets[hash % num_buckets];
+
+	// Replace the entry of the same position if there is one.
+	// Otherwise replace the entry from the oldest search with
+	// the lowest depth.
+	TTEntry *replace = &bucket.entries[0];
+	int replace_value = INT_MAX;
+
+	for(int i = 0; i < kTTBucketSize; ++i)
+	{
+		TTEntry *entry = &bucket.entries[i];
+		u64 entry_data = entry->data.load(std::memory_order_relaxed);
+		u64 entry_key = entry->key.load(std::memory_order_relaxed);
+
+		if(entry_data == 0 || (entry_key ^ entry_data) == hash)
+		{
+			// Keep the old move if we don't have a new one.
+			if(best_move == kPackedMoveNone && entry_data != 0)
+				best_move = unpack_data(entry_data).best_move;
+
+			// A bound doesn't replace a much deeper entry of the same
+			// position from this search, whatever that entry's type.
+			// An exact score always replaces it.
+			if(entry_data != 0
+				&& type != TTENTRY_EXACT
+				&& entry_generation(entry_data) == generation
+				&& entry_depth(entry_data) > depth + 2)
+				return;
+
+			replace = entry;
+			break;
+		}
+
+		int age = (generation - entry_generation(entry_data)) & kGenerationMask;
+		int value = entry_depth(entry_data) - 8 * age;
+		if(value < replace_value)
+		{
+			replace_value = value;
+			replace = entry;
+		}
+	}
+
+	u64 data = pack_data(evaluation, depth, type, best_move, generation);
+	replace->key.store(hash ^ data, std::memory_order_relaxed);
+	replace->data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::Prefetch(u64 hash) const
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(&buckets[hash % num_buckets]);
+#endif
+}
+
+int TranspositionTable::Hashfull() const
+{
+	int used = 0;
+	u64 sample = (num_buckets < 1000)?num_buckets:1000;
+
+	for(u64 i = 0; i < sample; ++i)
+	{
+		for(int j = 0; j < kTTBucketSize; ++j)
+		{
+			u64 entry_data = buckets[i].entries[j].data.load(std::memory_order_relaxed);
+			if(entry_data != 0 && entry_generation(entry_data) == generation)
+				++used;
+		}
+	}
+
+	return (int)(used * 1000 / (sample * kTTBucketSize));
+}
@@ -4,33 +4,90 @@
 #include "types.h"
 #include "move.h"
 
+#include <atomic>
+
+const unsigned kDefaultTTSize = 64;
+
 enum TTEntryType
 {
+	TTENTRY_NONE,
 	TTENTRY_EXACT,
 	TTENTRY_UPPER,
 	TTENTRY_LOWER
 };
 
+// The table is shared by all the search threads without locking.
+// Each entry stores the hash xored with the data so that an entry
+// torn by two threads writing at the same time doesn't match the
+// hash when it's probed and is treated as a miss.
+//
+// Data bits 0-15: best move, 16-47: score, 48-55: depth,
+// 56-57: entry type, 58-63: generation.
 struct TTEntry
 {
-	u64 hash;
+	std::atomic<u64> key;
+	std::atomic<u64> data;
+};
+
+// Unpacked contents of an entry.
+struct TTData
+{
 	int evaluation;
+	int depth;
 	TTEntryType type;
-	Move best_move;
+	PackedMove best_move;
 };
 
+// Entries are grouped in buckets of the size of a cache line
+// so that a probe touches only one cache line. The alignment
+// makes new[] return cache line aligned memory (C++17).
+const int kTTBucketSize = 4;
+
+struct alignas(64) TTBucket
+{
+	TTEntry entries[kTTBucketSize];
+};
+
+static_assert(sizeof(TTBucket) == 64, "TTBucket must fill one cache line");
+
 class TranspositionTable
 {
-	TTEntry *entries;
+	TTBucket *buckets;
 
 	unsigned size_mb;
-	unsigned num_entries;
-	unsigned max_entries;
+	u64 num_buckets;
+	u8 generation;
 
 public:
-	TranspositionTable(unsigned size_mb);
+	TranspositionTable(unsigned size_mb = kDefaultTTSize);
+	~TranspositionTable();
+
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+	// Reallocates the table. The contents are cleared.
 	void SetSize(unsigned size_mb);
-	unsigned NumEntries() const {return num_entries;}
+
+	void Clear();
+
+	// Called at the start of every search so that entries
+	// from older searches are replaced first.
+	void NewSearch();
+
+	// Returns true and fills data if the position is in the table.
+	bool Probe(u64 hash, TTData *data) const;
+
+	void Store(u64 hash, int evaluation, int depth, TTEntryType type, PackedMove best_move);
+
+	// Prefetches the bucket of the hash into the cache.
+	void Prefetch(u64 hash) const;
+
+	// Returns an estimate of how full the table is in permill
+	// as the UCI hashfull info expects.
+	int Hashfull() const;
+
+	unsigned SizeMB() const {return size_mb;}
+	u64 NumEntries() const {return num_buckets * kTTBucketSize;}
 };
 
 #endif
@@ -0,0 +1,563 @@
+#include "tuner.h"
+#include "evaluate.h"
+#include "search.h"
+#include "gensfen.h"
+#include "fen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int kInfinite = evaluation::kMateScore + 1;
+
+    // Layout of the tuned values. Each value has
+    // a middlegame and an endgame part.
+    const int kMaterialOffset = 0;
+    const int kPsqOffset = kMaterialOffset + NUM_PIECES;
+    const int kMobilityOffset = kPsqOffset + NUM_PIECES * NUM_SQUARES;
+    const int kRookOnOpenFileIndex = kMobilityOffset + NUM_PIECES;
+    const int kRookOnSemiOpenFileIndex = kRookOnOpenFileIndex + 1;
+    const int kThreatByPawnIndex = kRookOnSemiOpenFileIndex + 1;
+    const int kThreatByMinorIndex = kThreatByPawnIndex + 1;
+    const int kThreatByRookIndex = kThreatByMinorIndex + 1;
+    const int kHangingPieceIndex = kThreatByRookIndex + 1;
+    const int kNumParameters = kHangingPieceIndex + 1;
+
+    // Coefficient of a value in the evaluation of a position.
+    struct TuningTerm
+    {
+        u16 index;
+        int16_t coefficient;
+    };
+
+    // A resolved position. The terms of the position are
+    // stored in a shared array to keep the entries small.
+    struct TuningEntry
+    {
+        uint32_t first_term;
+        u16 num_terms;
+        u8 phase;
+        u8 scale;
+
+        // 1 for a white win, 0.5 for a draw and 0 for a loss.
+        float result;
+
+        // Terms that aren't tuned from white's point of view.
+        float rest_mg;
+        float rest_eg;
+    };
+
+    struct TuningSet
+    {
+        std::vector<TuningEntry> entries;
+        std::vector<TuningTerm> terms;
+    };
+
+    // Middlegame and endgame part of each value interleaved.
+    using Parameters = std::vector<double>;
+
+    struct RawPosition
+    {
+        std::string epd;
+        PackedPosition packed;
+        float result;
+    };
+
+    void initial_parameters(Parameters *parameters)
+    {
+        parameters->assign(2 * kNumParameters, 0.0);
+
+        auto set = [parameters](int index, Score value){
+            (*parameters)[2 * index] = value.mg;
+            (*parameters)[2 * index + 1] = value.eg;
+        };
+
+        for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+        {
+            set(kMaterialOffset + piece, evaluation::kPieceValues[piece]);
+            set(kMobilityOffset + piece, evaluation::kMobilityWeight[piece]);
+
+            for(int square = A8; square < NUM_SQUARES; ++square)
+            {
+                set(kPsqOffset + piece * NUM_SQUARES + square,
+                    {evaluation::kMiddlegameTables[piece][square], evaluation::kEndgameTables[piece][square]});
+            }
+        }
+
+        set(kRookOnOpenFileIndex, evaluation::kRookOnOpenFile);
+        set(kRookOnSemiOpenFileIndex, evaluation::kRookOnSemiOpenFile);
+        set(kThreatByPawnIndex, evaluation::kThreatByPawn);
+        set(kThreatByMinorIndex, evaluation::kThreatByMinor);
+        set(kThreatByRookIndex, evaluation::kThreatByRook);
+        set(kHangingPieceIndex, evaluation::kHangingPiece);
+    }
+
+    void collect_terms(const evaluation::EvalTrace& trace, std::vector<TuningTerm> *terms)
+    {
+        auto add = [terms](int index, int coefficient){
+            if(coefficient != 0)
+                terms->push_back({(u16)index, (int16_t)coefficient});
+        };
+
+        for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+        {
+            add(kMaterialOffset + piece, trace.material[piece]);
+            add(kMobilityOffset + piece, trace.mobility[piece]);
+
+            for(int square = A8; square < NUM_SQUARES; ++square)
+                add(kPsqOffset + piece * NUM_SQUARES + square, trace.psq[piece][square]);
+        }
+
+        add(kRookOnOpenFileIndex, trace.rook_on_open_file);
+        add(kRookOnSemiOpenFileIndex, trace.rook_on_semi_open_file);
+        add(kThreatByPawnIndex, trace.threat_by_pawn);
+        add(kThreatByMinorIndex, trace.threat_by_minor);
+        add(kThreatByRookIndex, trace.threat_by_rook);
+        add(kHangingPieceIndex, trace.hanging_piece);
+    }
+
+    // Reads the game result after the position fields. Accepts the 
+    // usual EPD forms: 1-0, 0-1, 1/2-1/2 or [1.0], [0.5], [0.0].
+    bool parse_epd_line(const std::string& line, RawPosition *position)
+    {
+        Bitboard pieces[NUM_PIECE_TYPES];
+        State state;
+        std::string_view rest;
+        if(!fen::parse_epd(line, pieces, &state, &rest))
+            return false;
+
+        position->epd = line;
+
+        if(rest.find("1/2") != std::string_view::npos || rest.find("[0.5]") != std::string_view::npos)
+            position->result = 0.5f;
+        else if(rest.find("1-0") != std::string_view::npos || rest.find("[1") != std::string_view::npos)
+            position->result = 1.0f;
+        else if(rest.find("0-1") != std::string_view::npos || rest.find("[0") != std::string_view::npos)
+            position->result = 0.0f;
+        else
+            return false;
+
+        return true;
+    }
+
+    bool load_positions(const std::string& path, std::vector<RawPosition> *positions)
+    {
+        bool binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+
+        if(binary)
+        {
+            std::FILE *file = std::fopen(path.c_str(), "rb");
+            if(file == nullptr)
+                return false;
+
+            RawPosition position;
+            while(std::fread(&position.packed, sizeof(PackedPosition), 1, file) == 1)
+            {
+                // The packed result is from the side to move's point of view.
+                int result = position.packed.result;
+                if(position.packed.flags & 1)
+                    result = -result;
+
+                position.result = (result + 1) / 2.0f;
+                positions->push_back(position);
+            }
+
+            std::fclose(file);
+            return true;
+        }
+
+        std::ifstream file(path);
+        if(!file)
+            return false;
+
+        std::string line;
+        RawPosition position;
+        while(std::getline(file, line))
+        {
+            if(parse_epd_line(line, &position))
+                positions->push_back(position);
+        }
+
+        return true;
+    }
+
+    // Plays the principal variation of the quiescence search so that
+    // the evaluation isn't done in the middle of an exchange. Returns
+    // false if the leaf is a mate or can't be evaluated by the terms.
+    bool resolve_position(Search *search, const RawPosition& raw, bool binary,
+                          TuningSet *set, const Parameters& parameters)
+    {
+        SearchThread *thread = search->threads[0].get();
+        Board *board = &thread->board;
+
+        if(binary)
+            gensfen::unpack_position(raw.packed, board);
+        else
+        {
+            std::string_view operations;
+            if(!board->SetPositionFromEPD(raw.epd, &operations))
+                return false;
+        }
+
+        Quiescence(search, thread, -kInfinite, kInfinite, 0);
+
+        Board leaf = *board;
+        for(int i = 0; i < thread->pv_length[0]; ++i)
+            leaf.MakeMove(thread->pv[0][i]);
+
+        if(leaf.InCheck(leaf.SideToMove()))
+            return false;
+
+        evaluation::EvalTrace trace;
+        evaluation::evaluate_trace(leaf, &trace);
+        if(!trace.linear)
+            return false;
+
+        TuningEntry entry;
+        entry.first_term = (uint32_t)set->terms.size();
+        entry.phase = (u8)trace.phase;
+        entry.scale = (u8)trace.scale;
+        entry.result = raw.result;
+
+        collect_terms(trace, &set->terms);
+        entry.num_terms = (u16)(set->terms.size() - entry.first_term);
+
+        // The rest is whatever the terms don't explain.
+        double mg = trace.total.mg;
+        double eg = trace.total.eg;
+        for(uint32_t i = entry.first_term; i < set->terms.size(); ++i)
+        {
+            const TuningTerm& term = set->terms[i];
+            mg -= term.coefficient * parameters[2 * term.index];
+            eg -= term.coefficient * parameters[2 * term.index + 1];
+        }
+
+        entry.rest_mg = (float)mg;
+        entry.rest_eg = (float)eg;
+
+        set->entries.push_back(entry);
+        return true;
+    }
+
+    // Resolves the positions on all the threads
+    // and merges the results into a single set.
+    void build_tuning_set(const std::vector<RawPosition>& positions, bool binary,
+                          int threads, const Parameters& parameters, TuningSet *set)
+    {
+        std::vector<TuningSet> partial(threads);
+        std::vector<std::thread> workers;
+
+        for(int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]{
+                // The search has no network, so the quiescence search
+                // uses the classical evaluation whose terms are tuned.
+                Search search;
+                search.silent = true;
+                search.transposition_table.SetSize(16);
+
+                size_t begin = positions.size() * t / threads;
+                size_t end = positions.size() * (t + 1) / threads;
+
+                for(size_t i = begin; i < end; ++i)
+                    resolve_position(&search, positions[i], binary, &partial[t], parameters);
+            });
+        }
+
+        for(std::thread& worker : workers)
+            worker.join();
+
+        for(const TuningSet& part : partial)
+        {
+            uint32_t offset = (uint32_t)set->terms.size();
+            set->terms.insert(set->terms.end(), part.terms.begin(), part.terms.end());
+
+            for(TuningEntry entry : part.entries)
+            {
+                entry.first_term += offset;
+                set->entries.push_back(entry);
+            }
+        }
+    }
+
+    inline double sigmoid(double k, double evaluation)
+    {
+        return 1.0 / (1.0 + std::pow(10.0, -k * evaluation / 400.0));
+    }
+
+    // Evaluation of the entry from white's point of view.
+    inline double linear_evaluation(const TuningSet& set, const TuningEntry& entry,
+                                    const double *parameters, double *mg_out, double *eg_out)
+    {
+        double mg = entry.rest_mg;
+        double eg = entry.rest_eg;
+
+        const TuningTerm *term = &set.terms[entry.first_term];
+        for(int i = 0; i < entry.num_terms; ++i, ++term)
+        {
+            mg += term->coefficient * parameters[2 * term->index];
+            eg += term->coefficient * parameters[2 * term->index + 1];
+        }
+
+        eg *= entry.scale / (double)kScaleNormal;
+
+        *mg_out = mg;
+        *eg_out = eg;
+        return (mg * entry.phase + eg * (evaluation::kMaxPhase - entry.phase)) / evaluation::kMaxPhase;
+    }
+
+    // Runs fn(begin, end, thread index) on the threads
+    // with the entries split evenly between them.
+    template <typename Function>
+    void parallel_for(size_t size, int threads, Function fn)
+    {
+        std::vector<std::thread> workers;
+        for(int t = 0; t < threads; ++t)
+            workers.emplace_back(fn, size * t / threads, size * (t + 1) / threads, t);
+
+        for(std::thread& worker : workers)
+            worker.join();
+    }
+
+    double mean_squared_error(const TuningSet& set, const Parameters& parameters, double k, int threads)
+    {
+        std::vector<double> errors(threads, 0.0);
+
+        parallel_for(set.entries.size(), threads, [&](size_t begin, size_t end, int t){
+            double mg, eg, error = 0.0;
+            for(size_t i = begin; i < end; ++i)
+            {
+                const TuningEntry& entry = set.entries[i];
+                double difference = entry.result - sigmoid(k, linear_evaluation(set, entry, parameters.data(), &mg, &eg));
+                error += difference * difference;
+            }
+            errors[t] = error;
+        });
+
+        double total = 0.0;
+        for(double error : errors)
+            total += error;
+
+        return total / std::max<size_t>(set.entries.size(), 1);
+    }
+
+    // Finds the sigmoid scaling that fits the current
+    // values best with a narrowing line search.
+    double find_k(const TuningSet& set, const Parameters& parameters, int threads)
+    {
+        double best_k = 1.0;
+        double best_error = mean_squared_error(set, parameters, best_k, threads);
+
+        for(double step = 0.1; step >= 0.0001; step /= 10)
+        {
+            double center = best_k;
+            for(int i = -10; i <= 10; ++i)
+            {
+                double k = center + i * step;
+                if(k <= 0.0)
+                    continue;
+
+                double error = mean_squared_error(set, parameters, k, threads);
+                if(error < best_error)
+                {
+                    best_error = error;
+                    best_k = k;
+                }
+            }
+        }
+
+        return best_k;
+    }
+
+    // Gradient of the mean squared error with respect to the values.
+    double compute_gradient(const TuningSet& set, const Parameters& parameters,
+                            double k, int threads, std::vector<double> *gradient)
+    {
+        std::vector<std::vector<double>> partial(threads, std::vector<double>(parameters.size(), 0.0));
+        std::vector<double> errors(threads, 0.0);
+
+        parallel_for(set.entries.size(), threads, [&](size_t begin, size_t end, int t){
+            double *local = partial[t].data();
+            double mg, eg, error = 0.0;
+
+            for(size_t i = begin; i < end; ++i)
+            {
+                const TuningEntry& entry = set.entries[i];
+                double s = sigmoid(k, linear_evaluation(set, entry, parameters.data(), &mg, &eg));
+                double difference = s - entry.result;
+                error += difference * difference;
+
+                // d(error)/d(evaluation) up to the constant 2 * k * ln(10) / 400.
+                double derivative = difference * s * (1.0 - s);
+                double mg_factor = derivative * entry.phase / evaluation::kMaxPhase;
+                double eg_factor = derivative * (evaluation::kMaxPhase - entry.phase) / evaluation::kMaxPhase
+                                 * entry.scale / kScaleNormal;
+
+                const TuningTerm *term = &set.terms[entry.first_term];
+                for(int j = 0; j < entry.num_terms; ++j, ++term)
+                {
+                    local[2 * term->index] += mg_factor * term->coefficient;
+                    local[2 * term->index + 1] += eg_factor * term->coefficient;
+                }
+            }
+
+            errors[t] = error;
+        });
+
+        double error = 0.0;
+        gradient->assign(parameters.size(), 0.0);
+        for(int t = 0; t < threads; ++t)
+        {
+            error += errors[t];
+            for(size_t i = 0; i < parameters.size(); ++i)
+                (*gradient)[i] += partial[t][i];
+        }
+
+        return error / std::max<size_t>(set.entries.size(), 1);
+    }
+
+    void print_score(std::ostream& os, const Parameters& parameters, int index)
+    {
+        os << "{" << (int)std::round(parameters[2 * index]) << ", "
+           << (int)std::round(parameters[2 * index + 1]) << "}";
+    }
+
+    void print_table(std::ostream& os, const Parameters& parameters, const char *name, int part)
+    {
+        static const char *kPieceNames[NUM_PIECES] = {"Pawns", "Knights", "Bishops", "Rooks", "Queens", "Kings"};
+
+        os << "const int " << name << "[NUM_PIECES][NUM_SQUARES] =\n{\n";
+        for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+        {
+            os << "\t{ // " << kPieceNames[piece] << "\n";
+            for(int rank = 0; rank < NUM_RANKS; ++rank)
+            {
+                os << "\t\t";
+                for(int file = 0; file < NUM_FILES; ++file)
+                {
+                    int index = kPsqOffset + piece * NUM_SQUARES + rank * NUM_FILES + file;
+                    os << std::setw(4) << (int)std::round(parameters[2 * index + part]);
+                    if(rank * NUM_FILES + file != NUM_SQUARES - 1) os << ",";
+                }
+                os << "\n";
+            }
+            os << "\t}" << ((piece != KINGS)?",":"") << "\n";
+        }
+        os << "};\n\n";
+    }
+
+    void print_parameters(std::ostream& os, const Parameters& parameters)
+    {
+        os << "const Score kPieceValues[NUM_PIECES] = \n{\n    ";
+        for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+        {
+            print_score(os, parameters, kMaterialOffset + piece);
+            os << ((piece != KINGS)?", ":"\n};\n\n");
+        }
+
+        os << "const Score kMobilityWeight[NUM_PIECES] = {";
+        for(int piece = PAWNS; piece < NUM_PIECES; ++piece)
+        {
+            print_score(os, parameters, kMobilityOffset + piece);
+            os << ((piece != KINGS)?", ":"};\n\n");
+        }
+
+        const std::pair<const char*, int> kScores[] =
+        {
+            {"kRookOnOpenFile", kRookOnOpenFileIndex}, {"kRookOnSemiOpenFile", kRookOnSemiOpenFileIndex},
+            {"kThreatByPawn", kThreatByPawnIndex}, {"kThreatByMinor", kThreatByMinorIndex},
+            {"kThreatByRook", kThreatByRookIndex}, {"kHangingPiece", kHangingPieceIndex}
+        };
+
+        for(const auto& score : kScores)
+        {
+            os << "const Score " << score.first << " = ";
+            print_score(os, parameters, score.second);
+            os << ";\n";
+        }
+        os << "\n";
+
+        print_table(os, parameters, "kMiddlegameTables", 0);
+        print_table(os, parameters, "kEndgameTables", 1);
+    }
+}
+
+namespace tuner
+{
+
+void tune(const TunerParameters& parameters)
+{
+    int threads = parameters.threads;
+    if(threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<RawPosition> positions;
+    if(!load_positions(parameters.input, &positions))
+    {
+        std::cout << "Couldn't open " << parameters.input << "\n";
+        return;
+    }
+
+    bool binary = parameters.input.size() >= 4
+        && parameters.input.compare(parameters.input.size() - 4, 4, ".bin") == 0;
+
+    Parameters values;
+    initial_parameters(&values);
+
+    TuningSet set;
+    build_tuning_set(positions, binary, threads, values, &set);
+    positions = std::vector<RawPosition>();
+
+    std::cout << "Loaded " << set.entries.size() << " positions with "
+              << set.terms.size() << " terms\n";
+
+    if(set.entries.empty())
+        return;
+
+    double k = find_k(set, values, threads);
+    std::cout << "K " << k << " error " << std::setprecision(8)
+              << mean_squared_error(set, values, k, threads) << "\n";
+
+    // Adam keeps the step size similar for values
+    // whose coefficients have very different scales.
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    const double epsilon = 1e-8;
+
+    std::vector<double> gradient;
+    std::vector<double> momentum(values.size(), 0.0);
+    std::vector<double> velocity(values.size(), 0.0);
+
+    for(int epoch = 1; epoch <= parameters.epochs; ++epoch)
+    {
+        double error = compute_gradient(set, values, k, threads, &gradient);
+
+        double correction1 = 1.0 - std::pow(beta1, epoch);
+        double correction2 = 1.0 - std::pow(beta2, epoch);
+
+        for(size_t i = 0; i < values.size(); ++i)
+        {
+            momentum[i] = beta1 * momentum[i] + (1.0 - beta1) * gradient[i];
+            velocity[i] = beta2 * velocity[i] + (1.0 - beta2) * gradient[i] * gradient[i];
+
+            values[i] -= parameters.learning_rate * (momentum[i] / correction1)
+                / (std::sqrt(velocity[i] / correction2) + epsilon);
+        }
+
+        if(epoch % parameters.report_interval == 0 || epoch == parameters.epochs)
+            std::cout << "Epoch " << epoch << " error " << error << std::endl;
+    }
+
+    std::cout << "Final error " << mean_squared_error(set, values, k, threads) << "\n\n";
+    print_parameters(std::cout, values);
+}
+
+}
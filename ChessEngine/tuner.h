@@ -0,0 +1,41 @@
+#ifndef TUNER_H_
+#define TUNER_H_
+
+#include <string>
+
+// Parameters of the tune command.
+struct TunerParameters
+{
+    // EPD file with a game result on each line or
+    // a binary file written by gensfen (.bin).
+    std::string input;
+
+    int epochs = 1000;
+
+    // 0 to use all the cores.
+    int threads = 0;
+
+    // Adam step size in centipawns.
+    double learning_rate = 1.0;
+
+    // Epochs between the progress reports.
+    int report_interval = 50;
+};
+
+// Texel tuning of the linear terms of the classical evaluation.
+//
+// Every position is resolved with the quiescence search and
+// the evaluation of the quiet leaf is written as a list of
+// coefficients of the tunable values plus a constant for the
+// terms that aren't tuned. An epoch is then a sparse dot product
+// per position instead of a full evaluation. The values are
+// optimized with gradient descent on the squared error between
+// the game results and the sigmoid of the evaluation.
+namespace tuner
+{
+    // Loads the positions, tunes the values and prints
+    // them as C++ tables that replace the ones in evaluate.
+    void tune(const TunerParameters& parameters);
+}
+
+#endif // TUNER_H_
@@ -5,6 +5,7 @@
 #include <climits>
 
 using u8 = uint8_t;
+using u16 = uint16_t;
 using u64 = uint64_t;
 using Bitboard = u64;
 
@@ -115,5 +116,20 @@ enum Castling
     WHITE_KINGSIDE = 0x8
 };
 
+// A pair of middlegame and endgame evaluation terms. The
+// evaluation interpolates between them by the game phase.
+struct Score
+{
+    int mg;
+    int eg;
+};
+
+inline Score operator+(Score a, Score b) {return {a.mg + b.mg, a.eg + b.eg};}
+inline Score operator-(Score a, Score b) {return {a.mg - b.mg, a.eg - b.eg};}
+inline Score operator-(Score a) {return {-a.mg, -a.eg};}
+inline Score operator*(Score a, int b) {return {a.mg * b, a.eg * b};}
+inline Score& operator+=(Score& a, Score b) {a.mg += b.mg; a.eg += b.eg; return a;}
+inline Score& operator-=(Score& a, Score b) {a.mg -= b.mg; a.eg -= b.eg; return a;}
+
 
 #endif // TYPES_H 
@@ -1,8 +1,14 @@
 #include <iostream>
 #include <string>
 #include <sstream>
-#include <thread>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <type_traits>
 
 #include "uci.h"
 #include "move_generation.h"
@@ -10,6 +16,12 @@
 #include "util.h"
 #include "tests.h"
 #include "bitboards.h"
+#include "output.h"
+#include "options.h"
+#include "engine.h"
+#include "gensfen.h"
+#include "tuner.h"
+#include "match.h"
 
 
 namespace 
@@ -20,53 +32,167 @@ namespace
 		while (*is >> token) tokens->push_back(token);
 	}
 
-    const std::string kFenStartPosition = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    // Single producer, single consumer queue of command lines.
+    // The input thread pushes and the UCI loop pops, so the queue
+    // itself needs no locks. The mutex and condition variable are
+    // only used to put the UCI loop to sleep when there's no input.
+    class CommandQueue
+    {
+    public:
+        void Push(std::string command)
+        {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+
+            // Full. The UCI loop is busy with a long command.
+            while(tail - head_.load(std::memory_order_acquire) == kCapacity)
+                std::this_thread::yield();
+
+            slots_[tail % kCapacity] = std::move(command);
+            pending_.fetch_add(1, std::memory_order_relaxed);
+            tail_.store(tail + 1, std::memory_order_release);
+
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            not_empty_.notify_one();
+        }
+
+        // Blocks until a command is available.
+        std::string Pop()
+        {
+            size_t head = head_.load(std::memory_order_relaxed);
+
+            if(head == tail_.load(std::memory_order_acquire))
+            {
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                not_empty_.wait(lock, [this, head]{
+                    return head != tail_.load(std::memory_order_acquire);
+                });
+            }
+
+            std::string command = std::move(slots_[head % kCapacity]);
+            head_.store(head + 1, std::memory_order_release);
+            return command;
+        }
+
+        // Called by the UCI loop when it has finished executing a command.
+        void CommandDone()
+        {
+            pending_.fetch_sub(1, std::memory_order_release);
+        }
+
+        // True when every pushed command has been executed.
+        bool Idle() const
+        {
+            return pending_.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        static const size_t kCapacity = 1024;
 
-	void position(Board *board, const std::vector<std::string> &tokens)
+        std::string slots_[kCapacity];
+        std::atomic<size_t> head_{0};
+        std::atomic<size_t> tail_{0};
+        std::atomic<int> pending_{0};
+
+        std::mutex sleep_mutex_;
+        std::condition_variable not_empty_;
+    };
+
+    // Reads the input on its own thread so that stop, isready and 
+    // quit are handled immediately even when the UCI loop is busy.
+    void read_input(Search *search, CommandQueue *queue)
+    {
+        std::string line;
+        while(std::getline(std::cin, line))
+        {
+            std::istringstream iss(line);
+            std::string command;
+            iss >> command;
+
+            if(command == "stop" || command == "quit")
+            {
+                // Still queued so that a stop that arrives 
+                // before its go has been started isn't lost.
+                TerminateSearch(search,true);
+            }
+            else if(command == "isready" && queue->Idle())
+            {
+                // Nothing to synchronize with, the
+                // previous commands have been executed.
+                output::send("readyok");
+                continue;
+            }
+
+            queue->Push(line);
+
+            if(command == "quit")
+                return;
+        }
+
+        queue->Push("quit");
+    }
+
+	void position(Engine *engine, const std::vector<std::string> &tokens)
 	{
 		if (tokens.size() == 0)
 		{
-			std::cout << "Missing arguments\n";
+			output::send("info string Missing arguments");
 			return;
 		}
 
-		int curr_token = 0;
+		std::string fen;
+		size_t curr_token = 0;
 		if (tokens[curr_token] == "fen")
 		{
-			std::string fen;
 			while (++curr_token < tokens.size() && tokens[curr_token] != "moves")
 			{
 				// Manually add the spaces to the fen string.
 				// We got rid of them when tokenizing the input.
 				fen += tokens[curr_token] + ' ';
 			}
-
-			board->SetPositionFromFEN(fen);
 		}
 		else if (tokens[curr_token] == "startpos")
 		{
-			board->SetPositionFromFEN(kFenStartPosition);
+			fen = kFenStartPosition;
 			++curr_token;
 		}
 		else return;
 
-        if(curr_token < tokens.size() && tokens[curr_token] == "moves")
+		std::vector<std::string> moves;
+		if (curr_token < tokens.size() && tokens[curr_token] == "moves")
+			moves.assign(tokens.begin() + curr_token + 1, tokens.end());
+
+		if (!engine->SetPosition(fen, moves))
+			output::send("info string Invalid position or illegal moves in move list.");
+	}
+
+    // setoption name <id> [value <x>]
+    // Both the name and the value may contain spaces.
+    void set_option(Engine *engine, const std::vector<std::string>& tokens)
+    {
+        if(tokens.size() < 2 || tokens[0] != "name")
         {
-			while (++curr_token < tokens.size())
-			{
-                Move m = move_from_uci(*board,tokens[curr_token]);
+            output::send("info string setoption name <id> [value <x>]");
+            return;
+        }
 
-                if(m.type != MOVE_TYPE_NONE)
-                {
-                    board->MakeMove(m);
-                }
-				else
-				{
-					board->Reset();
-					std::cout << "Illegal moves in move list." << std::endl;
-				}
-			}
+        std::string name, value;
+        std::string *current = &name;
+
+        for(size_t i = 1; i < tokens.size(); ++i)
+        {
+            if(tokens[i] == "value" && current == &name)
+            {
+                current = &value;
+                continue;
+            }
+
+            if(!current->empty()) *current += ' ';
+            *current += tokens[i];
         }
+
+        std::string error;
+        if(!engine->SetOption(name, value, &error))
+            output::send("info string " + error);
     }
 
     void print_help()
@@ -79,9 +205,13 @@ namespace
                    "position [fen | startpos] moves ...\n\tSet up the position described in fenstring on the internal board and play the moves.\n"<<
                    "go\n\tStart calculating on the current position set up with the position command.\n"<<
                    "stop\n\tStop calculating as soon as possible.\n"<<
-                   "ponderhit\n\tThe used has played the expected move.\n"<<
+                   "ponderhit\n\tThe user has played the expected move.\n"<<
                    "perft [fen] [depth]\n"<<
-                   "quit\n\tQuit the program as soon as possible\n"<<std::endl;
+                   "test\n\tRun the checks of the board functions.\n"<<
+                   "gensfen [depth d] [nodes n] [count c] [threads t] [random_moves r] [max_ply p] [eval_limit e] [hash mb] [output file]\n\tGenerate training positions from self-play games.\n"<<
+                   "tune file [epochs n] [threads t] [rate r] [report n]\n\tTune the evaluation on the positions in an EPD or gensfen file.\n"<<
+                   "match [openings file] [games n] [threads t] [tc base+inc] [nodes n] [hash mb] [maxply n] [elo0 e] [elo1 e] [alpha a] [beta b] [param name value]...\n\tPlay a match against the engine with changed search parameters.\n"<<
+                   "quit\n\tQuit the program as soon as possible\n"<<"\n";
     }
 
     void print_legal_moves(Board *board, const std::vector<std::string>& tokens) 
@@ -144,11 +274,11 @@ namespace
         }
         else
         {
-            std::cout<<"Unkown command: legal "<<token<<std::endl;
+            std::cout<<"Unkown command: legal "<<token<<"\n";
             return;
         }
 
-        std::cout<<"Number of legal moves: "<<move_list.size()<<std::endl;
+        std::cout<<"Number of legal moves: "<<move_list.size()<<"\n";
         for(int i=0;i<move_list.size();++i)
         {
             std::string from = algebraic_from_square(move_list[i].from);
@@ -165,50 +295,277 @@ namespace
 			if (move_list[i].type == PROMOTION)
 				std::cout << " to " << get_piece_name(move_list[i].promotion);
 
-			std::cout << std::endl;
+			std::cout << "\n";
 
 			
         }
     }
 
+    // Parses the value that follows the go parameter at *i and
+    // moves *i to it. Prints an error and returns false if the
+    // value isn't a number.
+    template <typename T>
+    bool parse_go_value(const std::vector<std::string>& tokens, size_t *i, T *value)
+    {
+        const std::string& name = tokens[*i];
+        const std::string& token = tokens[++*i];
+
+        try
+        {
+            if constexpr(std::is_same_v<T, u64>)
+                *value = std::stoull(token);
+            else
+                *value = std::stoi(token);
+        }
+        catch(const std::exception&)
+        {
+            output::send("info string Invalid value for " + name + ": " + token);
+            return false;
+        }
+
+        return true;
+    }
+
     void go(Search *search, Board *board, const std::vector<std::string>& tokens)
     {
-		for (int i=0; i<tokens.size(); ++i)
+        // Limits that aren't given are unlimited.
+        search->depth = 0;
+        search->nodes = 0;
+        search->duration = 0;
+        search->infinite = false;
+        search->ponder = false;
+
+        int time_left[NUM_SIDES] = {0, 0};
+        int increment[NUM_SIDES] = {0, 0};
+        int moves_to_go = 0;
+
+		for (size_t i=0; i<tokens.size(); ++i)
 		{
 			if (tokens[i] == "infinite")
 			{
 				search->duration = 0;
+				search->infinite = true;
+			}
+			else if (tokens[i] == "ponder")
+			{
+				// The limits are for the search after the ponder hit.
+				search->ponder = true;
 			}
 			else if (tokens[i] == "movetime")
 			{
                 if(i == tokens.size()-1)
                 {
-                    std::cout<<"Missing parameter to "<<tokens[i]<<"\n";
+                    output::send("info string Missing parameter to " + tokens[i]);
                     return;
                 }
 
-				search->duration = std::stoi(tokens[++i],nullptr,10);
+				if(!parse_go_value(tokens, &i, &search->duration)) return;
 			}
             else if (tokens[i] == "nodes")
             {
                 if(i == tokens.size()-1)
                 {
-                    std::cout<<"Missing parameter to "<<tokens[i]<<"\n";
+                    output::send("info string Missing parameter to " + tokens[i]);
                     return;
                 }
-				search->nodes = std::stoi(tokens[++i],nullptr,10);
-
+				if(!parse_go_value(tokens, &i, &search->nodes)) return;
             }
             else if (tokens[i] == "depth")
             {
                 if(i == tokens.size()-1)
                 {
-                    std::cout<<"Missing parameter to "<<tokens[i]<<"\n";
+                    output::send("info string Missing parameter to " + tokens[i]);
                     return;
                 }
-				search->depth = std::stoi(tokens[++i],nullptr,10);
+				if(!parse_go_value(tokens, &i, &search->depth)) return;
+            }
+            else if (tokens[i] == "wtime" || tokens[i] == "btime" || tokens[i] == "winc" 
+                  || tokens[i] == "binc" || tokens[i] == "movestogo")
+            {
+                if(i == tokens.size()-1)
+                {
+                    output::send("info string Missing parameter to " + tokens[i]);
+                    return;
+                }
+
+                const std::string& name = tokens[i];
+                int value;
+                if(!parse_go_value(tokens, &i, &value)) return;
+
+                if(name == "wtime") time_left[WHITE] = value;
+                else if(name == "btime") time_left[BLACK] = value;
+                else if(name == "winc") increment[WHITE] = value;
+                else if(name == "binc") increment[BLACK] = value;
+                else moves_to_go = value;
             }
 		}
+
+        // An explicit movetime overrides the clock.
+        Side side = board->SideToMove();
+        if(search->duration == 0 && !search->infinite && time_left[side] > 0)
+            search->duration = AllocateTime(search, time_left[side], increment[side], moves_to_go);
+    }
+
+    // The games are played with the network of the session.
+    void generate_training_data(const std::vector<std::string>& tokens, const Engine& engine)
+    {
+        GenSfenParameters parameters;
+        parameters.network = engine.search.network;
+
+        for(size_t i = 0; i < tokens.size(); ++i)
+        {
+            if(i == tokens.size()-1)
+            {
+                output::send("info string Missing parameter to " + tokens[i]);
+                return;
+            }
+
+            const std::string& name = tokens[i];
+            const std::string& value = tokens[++i];
+
+            try
+            {
+                if(name == "depth") parameters.depth = std::stoi(value);
+                else if(name == "nodes") parameters.nodes = std::stoull(value);
+                else if(name == "count") parameters.count = std::stoull(value);
+                else if(name == "threads") parameters.threads = std::stoi(value);
+                else if(name == "random_moves") parameters.random_moves = std::stoi(value);
+                else if(name == "max_ply") parameters.max_ply = std::stoi(value);
+                else if(name == "eval_limit") parameters.eval_limit = std::stoi(value);
+                else if(name == "hash") parameters.hash_mb = std::stoi(value);
+                else if(name == "output") parameters.output = value;
+                else
+                {
+                    output::send("info string Unknown gensfen parameter: " + name);
+                    return;
+                }
+            }
+            catch(const std::exception&)
+            {
+                output::send("info string Invalid value for " + name + ": " + value);
+                return;
+            }
+        }
+
+        gensfen::generate(parameters);
+    }
+
+    void tune(const std::vector<std::string>& tokens)
+    {
+        if(tokens.empty())
+        {
+            output::send("info string tune <file>");
+            return;
+        }
+
+        TunerParameters parameters;
+        parameters.input = tokens[0];
+
+        for(size_t i = 1; i < tokens.size(); ++i)
+        {
+            if(i == tokens.size()-1)
+            {
+                output::send("info string Missing parameter to " + tokens[i]);
+                return;
+            }
+
+            const std::string& name = tokens[i];
+            const std::string& value = tokens[++i];
+
+            try
+            {
+                if(name == "epochs") parameters.epochs = std::stoi(value);
+                else if(name == "threads") parameters.threads = std::stoi(value);
+                else if(name == "rate") parameters.learning_rate = std::stod(value);
+                else if(name == "report") parameters.report_interval = std::max(1, std::stoi(value));
+                else
+                {
+                    output::send("info string Unknown tune parameter: " + name);
+                    return;
+                }
+            }
+            catch(const std::exception&)
+            {
+                output::send("info string Invalid value for " + name + ": " + value);
+                return;
+            }
+        }
+
+        tuner::tune(parameters);
+    }
+
+    void play_match(const std::vector<std::string>& tokens, const Engine& engine)
+    {
+        MatchParameters parameters;
+        parameters.network = engine.search.network;
+
+        for(size_t i = 0; i < tokens.size(); ++i)
+        {
+            size_t needed = (tokens[i] == "param")?2:1;
+            if(i + needed >= tokens.size())
+            {
+                output::send("info string Missing parameter to " + tokens[i]);
+                return;
+            }
+
+            const std::string& name = tokens[i];
+            const std::string& value = tokens[++i];
+
+            try
+            {
+                if(name == "openings") parameters.openings = value;
+                else if(name == "games") parameters.games = std::stoi(value);
+                else if(name == "threads") parameters.threads = std::stoi(value);
+                else if(name == "nodes") parameters.nodes = std::stoull(value);
+                else if(name == "hash") parameters.hash_mb = std::stoi(value);
+                else if(name == "maxply") parameters.max_ply = std::stoi(value);
+                else if(name == "elo0") parameters.elo0 = std::stod(value);
+                else if(name == "elo1") parameters.elo1 = std::stod(value);
+                else if(name == "alpha") parameters.alpha = std::stod(value);
+                else if(name == "beta") parameters.beta = std::stod(value);
+                else if(name == "tc")
+                {
+                    // Seconds, for example 10+0.1. The whole 
+                    // value has to be numbers.
+                    size_t plus = value.find('+');
+                    size_t length = 0;
+                    std::string base = value.substr(0, plus);
+                    parameters.base_time = (int)(std::stod(base, &length) * 1000);
+                    if(length != base.size())
+                        throw std::invalid_argument(value);
+
+                    parameters.increment = 0;
+                    if(plus != std::string::npos)
+                    {
+                        std::string increment = value.substr(plus + 1);
+                        parameters.increment = (int)(std::stod(increment, &length) * 1000);
+                        if(length != increment.size())
+                            throw std::invalid_argument(value);
+                    }
+                }
+                else if(name == "param")
+                {
+                    if(!SetSearchParameter(&parameters.test_params, value, tokens[i + 1]))
+                    {
+                        output::send("info string Invalid search parameter: " + value + " " + tokens[i + 1]);
+                        return;
+                    }
+                    ++i;
+                }
+                else
+                {
+                    output::send("info string Unknown match parameter: " + name);
+                    return;
+                }
+            }
+            catch(const std::exception&)
+            {
+                output::send("info string Invalid value for " + name + ": " + value);
+                return;
+            }
+        }
+
+        match::run(parameters);
     }
 
 	void list_attacked(Board *board)
@@ -227,6 +584,12 @@ namespace
 		if (tokens.size() < 1) return;
 
 		Move move = move_from_uci(*board,tokens[0]);
+		if (move.type == MOVE_TYPE_NONE || !board->IsLegal(move))
+		{
+			std::cout << "Illegal move.\n";
+			return;
+		}
+
 		board->MakeMove(move);
 	}
 
@@ -307,20 +670,27 @@ namespace
 
 namespace uci
 {
-    void loop()
+    void loop(bool interactive)
     {
-        Board board;
-        Search search;
+        Engine engine;
+        Board& board = engine.board;
+        Search& search = engine.search;
+        Options& options = engine.options;
+
+        CommandQueue queue;
 
-		bool search_active = false;
+        std::thread input_thread(read_input, &search, &queue);
 
         std::string line, command;
         for(;;)
         {
-			std::cout << "<<";
-            getline(std::cin,line);
+            if(interactive)
+                std::cout << "<<" << std::flush;
+
+            line = queue.Pop();
 
             std::istringstream iss(line);
+            command.clear();
             iss >> std::skipws >> command;
 
 			std::vector<std::string> tokens;
@@ -328,31 +698,40 @@ namespace uci
 
             if(command == "uci")
             {
-                std::cout << "id name chess engine\n"
-                          << "id author Jan S\n"
-                          << "uciok\n";
+                // A GUI is talking to us.
+                interactive = false;
+
+                output::write_line("id name chess engine");
+                output::write_line("id author Jan S");
+                for(const std::string& description : options.UciDescriptions())
+                    output::write_line(description);
+                output::write_line("uciok");
+            }
+            else if(command == "setoption")
+            {
+                set_option(&engine, tokens);
             }
             else if(command == "position")
             {
-                position(&board, tokens);
+                position(&engine, tokens);
             }
             else if(command == "go")
             {
-				//if(search_active) continue;
-
-		        std::thread search_thread;
+                // Finish the previous search before 
+                // changing the limits it's reading.
+                TerminateSearch(&search,true);
+                WaitForSearchFinished(&search);
 
                 go(&search, &board, tokens);
-				search_thread = std::thread(StartSearch,&search,&board);
-                search_thread.detach();
-				search_active = true;
+                StartSearch(&search,board);
             }
             else if(command == "stop")
             {
-				if(!search_active) continue;
-
                 TerminateSearch(&search,true);
-				search_active = false;
+            }
+            else if(command == "ponderhit")
+            {
+                PonderHit(&search);
             }
             else if(command == "print")
             {
@@ -374,6 +753,10 @@ namespace uci
 			{
                 perft(&board, tokens);
 			}
+            else if(command == "test")
+            {
+                tests::start_board_tests();
+            }
 			else if (command == "attacks")
 			{
                 attacks(tokens);
@@ -402,35 +785,53 @@ namespace uci
 			}
 			else if (command == "ucinewgame")
 			{
-				// TODO
+				// The transposition table is kept between the
+				// moves of a game and cleared only here.
+				engine.NewGame();
 			}
+            else if(command == "gensfen")
+            {
+                generate_training_data(tokens, engine);
+            }
+            else if(command == "tune")
+            {
+                tune(tokens);
+            }
+            else if(command == "match")
+            {
+                play_match(tokens, engine);
+            }
 			else if (command == "fen")
 			{
 				std::cout << board.GenerateFenString() << "\n";
 			}
 			else if (command == "evaluate")
 			{
-				float evaluation = board.Evaluate();
-				std::cout << "Evaluation: " << std::fixed << std::setw(3) << std::setprecision(2) << evaluation << "\n";
+				std::cout << "Evaluation: " << board.Evaluate() << " cp\n";
 			}
             else if(command == "isready")
             {
-                std::cout<< "readyok\n"; 
+                output::write_line("readyok");
             }
             else if(command == "quit")
             {
-                exit(EXIT_SUCCESS);
+                break;
             }
-            else
+            else if(!command.empty())
             {
-                if(std::cin.eof())
-                {
-                    exit(EXIT_SUCCESS);
-                }
-
-                std::cout<<"Unknown command: "<< command << std::endl;
+                output::send("info string Unknown command: " + command);
             }
+
+            queue.CommandDone();
+
+            // Responses to the command, if any, are sent here.
+            output::flush();
         }
+
+        // The search threads are joined by the destructor
+        // of search once it has stopped.
+        TerminateSearch(&search,true);
+        input_thread.join();
     }
 }
 
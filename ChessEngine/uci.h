@@ -6,8 +6,10 @@
 namespace uci 
 {
     // Parses and executes UCI commands 
-    // from the user.
-    void loop();
+    // from the user. A prompt is printed before 
+    // each command in interactive mode. The prompt 
+    // is turned off by the uci command.
+    void loop(bool interactive = true);
 };
 
 #endif